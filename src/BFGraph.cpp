@@ -3,6 +3,7 @@
 
 #include "BuildContigs.hpp"
 #include "FilterReads.hpp"
+#include "BuildGraph.hpp"
 #include "Common.hpp"
 
 using namespace std;
@@ -18,6 +19,7 @@ void PrintUsage() {
   cout <<
        "    filter       Filters errors from reads" << endl <<
        "    contigs      Builds an initial contig graph" << endl <<
+       "    build        Runs filter and contigs in one go, parsing the reads only once" << endl <<
        "    cite         Prints information for citing the paper" << endl <<
        "    version      Displays version number" << endl << endl;
   ;
@@ -52,6 +54,8 @@ int main(int argc, char **argv) {
       FilterReads(argc-1,argv+1);
     } else if (strcmp(argv[1], "contigs") == 0) {
       BuildContigs(argc-1,argv+1);
+    } else if (strcmp(argv[1], "build") == 0) {
+      BuildGraph(argc-1,argv+1);
     } else {
       cout << "Did not understand command " << argv[1] << endl;
       PrintUsage();
@@ -4,15 +4,51 @@
 #include <cmath>
 #include <iostream>
 #include <cstdlib>
+#include <cstring>
+#include <algorithm>
 
 #include "hash.hpp"
 #include "libdivide.h"
+#include "LargeAlloc.hpp"
 
 
 
 static const uint64_t mask[8] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
 
 
+// the number of bits set in the n words of t, the loop is compiled a second
+// time for the popcnt instruction and that one is used when the CPU has it
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("popcnt")))
+static inline size_t popcount_words_hw(const uint64_t *t, size_t n) {
+  size_t c0 = 0, c1 = 0, c2 = 0, c3 = 0, i = 0;
+  for (; i + 4 <= n; i += 4) {
+    c0 += __builtin_popcountll(t[i]);
+    c1 += __builtin_popcountll(t[i+1]);
+    c2 += __builtin_popcountll(t[i+2]);
+    c3 += __builtin_popcountll(t[i+3]);
+  }
+  for (; i < n; i++) {
+    c0 += __builtin_popcountll(t[i]);
+  }
+  return c0 + c1 + c2 + c3;
+}
+#endif
+
+static inline size_t popcount_words(const uint64_t *t, size_t n) {
+#if defined(__x86_64__) && defined(__GNUC__)
+  if (__builtin_cpu_supports("popcnt")) {
+    return popcount_words_hw(t, n);
+  }
+#endif
+  size_t c = 0;
+  for (size_t i = 0; i < n; i++) {
+    c += __builtin_popcountll(t[i]);
+  }
+  return c;
+}
+
+
 /* Short description:
  *  - Extended BloomFilter which hashes into 64-bit blocks
  *    that can be accessed very fast from the CPU cache
@@ -43,10 +79,19 @@ class BlockedBloomFilter {
   }
 
 
+  // the number of bits in the filter
+  size_t bits() const {
+    return size_;
+  }
+
+  // the number of 512 bit blocks
+  size_t blocks() const {
+    return blocks_;
+  }
+
+  // the memory used by the filter in bytes, 64 bytes per block
   size_t memory() const {
-    size_t m = sizeof(BlockedBloomFilter) + (blocks_ / 64 );
-    fprintf(stderr, "BlockedBloomFilter:\t\t%zuMB\n",  m >> 20);
-    return m;
+    return sizeof(BlockedBloomFilter) + 64*blocks_;
   }
 
 
@@ -57,11 +102,41 @@ class BlockedBloomFilter {
   }
 
 
+  // the hash of x, contains(x) == containsHash(hash(x))
+  template<typename T>
+  uint64_t hash(T x) const {
+    uint64_t h; MurmurHash3_x64_64((const void *) &x, sizeof(T), seed_, &h);
+    return h;
+  }
+
+
+  // the block an item with hash h is stored in, 0 <= block(h) < blocks()
+  uint64_t block(uint64_t h) const {
+    return h - (h / fast_div_) * blocks_;
+  }
+
+
+  // start loading the block of an item with hash h into the cache,
+  // so a later containsHash(h) does not wait for memory
+  void prefetch(uint64_t h) const {
+    __builtin_prefetch(table_+8*block(h),0,1);
+  }
+
+
+  bool containsHash(uint64_t h) const {
+    return (searchHash(h) == 0);
+  }
+
+
   template<typename T>
   size_t search(T x) const {
+    return searchHash(hash(x));
+  }
+
+
+  size_t searchHash(uint64_t hash) const {
     //size_t r = k_;
 
-    uint64_t hash; MurmurHash3_x64_64((const void *) &x, sizeof(T), seed_, &hash);
     uint64_t hash0 = hash / fast_div_; // hash0 = hash / blocks;
     uint64_t block = hash - hash0 * blocks_; // blocks = hash % blocks;
     //uint64_t block; MurmurHash3_x64_64((const void *) &x, sizeof(T), seed_+2, &block);
@@ -96,8 +171,14 @@ class BlockedBloomFilter {
 
   template<typename T>
   size_t insert(T x) {
+    return insertHash(hash(x));
+  }
+
+
+  // the number of bits insertHash(h) set that were not set before,
+  // insert(x) == insertHash(hash(x))
+  size_t insertHash(uint64_t hash) {
     size_t r = 0;
-    uint64_t hash; MurmurHash3_x64_64((const void *) &x, sizeof(T), seed_, &hash);
     uint64_t hash0 = hash / fast_div_; // hash0 = hash / blocks;
     uint64_t block = hash - hash0 * blocks_; // blocks = hash % blocks;
     // block is the index of the 512 bit memory block where x would be stored
@@ -154,36 +235,65 @@ class BlockedBloomFilter {
   }
 
   size_t count() const {
-    unsigned char *t = (unsigned char *) table_;
-    size_t c = 0;
-    for (size_t i = 0; i < 64*blocks_; i++) {
-      unsigned char u = t[i];
-      for (size_t j = 128; j != 0; j = j>>1) {
-        if ((u & j) != 0) {
-          c++;
-        }
-      }
-    }
+    size_t c = popcount_words(table_, 8*blocks_);
     //std::cout << c << " bits set out of " << size_ << " with k = " << k_ << std::endl;
     if (c != 0) {
-      double n = size_*(-log(1.0-((double)c)/size_))/k_;
-      //cout << "estimate =" << (size_t)n  << endl;
-      return (size_t) n;
+      return estimate(((double) c)/size_);
     } else {
       return 0;
     }
   }
 
+  // use:  n = bf.estimate(fill);
+  // pre:  0 <= fill < 1 is the fraction of bits set
+  // post: n is the estimated number of items inserted into the filter
+  size_t estimate(double fill) const {
+    fill = std::min(fill, 1.0 - 1.0/size_); // a full filter holds at least this many
+    return (size_t) (size_*(-log(1.0-fill))/k_);
+  }
+
+  // use:  fp = bf.sample(samples, fill, maxfill);
+  // post: about samples blocks spread evenly over the filter, all of them if there
+  //       are fewer, have been counted, fill is the fraction of their bits that are set,
+  //       maxfill the fraction of the fullest one, and fp is the false positive rate
+  //       estimated from them, every block having its own rate since an item only uses one
+  double sample(size_t samples, double& fill, double& maxfill) const {
+    size_t step = std::max<size_t>(blocks_ / std::max<size_t>(samples, 1), 1);
+    size_t n = 0, set = 0, maxset = 0;
+    double fp = 0.0;
+    for (size_t b = 0; b < blocks_; b += step) {
+      size_t c = popcount_words(table_ + 8*b, 8);
+      set += c;
+      maxset = std::max(maxset, c);
+      fp += pow(c/512.0, (double) k_);
+      ++n;
+    }
+    fill = (n > 0) ? set/(512.0*n) : 0.0;
+    maxfill = maxset/512.0;
+    return (n > 0) ? fp/n : 0.0;
+  }
+
   void clear() {
     if (table_ != NULL) {
       //delete[] table_;
-      free(table_);
+      freeLarge(table_, 8*blocks_*sizeof(table_[0]));
     }
     table_ = NULL;
     size_ = 0;
     blocks_ = 0;
   }
 
+  // use:  bf.swap(other);
+  // post: bf and other have exchanged their tables and parameters
+  void swap(BlockedBloomFilter& other) {
+    std::swap(table_, other.table_);
+    std::swap(blocks_, other.blocks_);
+    std::swap(seed_, other.seed_);
+    std::swap(size_, other.size_);
+    std::swap(k_, other.k_);
+    std::swap(fast_div_, other.fast_div_);
+  }
+
  private:
 
 
@@ -191,7 +301,8 @@ class BlockedBloomFilter {
   void init_table() {
     fast_div_ = libdivide::divider<uint64_t>(blocks_);
     //table_ = new uint64_t[8*blocks_];
-    posix_memalign((void**)&table_, 64, 8*blocks_*sizeof(table_[0]));
+    // the blocks are probed at random, on hugepages they need fewer TLB entries
+    table_ = (uint64_t *) allocLarge(8*blocks_*sizeof(table_[0]));
     memset(table_, 0, 8*blocks_*sizeof(table_[0]));
   }
 
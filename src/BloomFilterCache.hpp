@@ -0,0 +1,70 @@
+#ifndef BFG_BLOOMFILTER_CACHE_HPP
+#define BFG_BLOOMFILTER_CACHE_HPP
+
+#include <algorithm>
+#include <vector>
+#include "Kmer.hpp"
+#include "BlockedBloomFilter.hpp"
+
+
+/* Short description:
+ *  - Direct-mapped cache of Bloom filter answers for canonical k-mers
+ *  - The walks from consecutive k-mers of a read check almost the same
+ *    neighbours, so most lookups are answered here without touching the filter
+ *  - Not threadsafe, every thread keeps its own cache,
+ *    all lookups between clears must use the same Bloom filter
+ * */
+class BloomFilterCache {
+ public:
+  BloomFilterCache(size_t bits = default_bits) : hits(0), misses(0), table_(1ULL << bits), shift_(64 - bits) {
+    clear();
+  }
+
+  // use:  b = cache.contains(bf, rep);
+  // pre:  rep is a canonical k-mer
+  // post: b == bf.contains(rep)
+  bool contains(const BlockedBloomFilter& bf, const Kmer& rep) {
+    Entry& e = table_[index(rep)];
+    if (e.km == rep) {
+      ++hits;
+      return e.present;
+    }
+    ++misses;
+    e.km = rep;
+    e.present = bf.contains(rep);
+    return e.present;
+  }
+
+  // use:  cache.clear();
+  // post: the cache is empty, the counters are unchanged
+  void clear() {
+    Entry empty;
+    empty.km.set_empty();
+    empty.present = false;
+    std::fill(table_.begin(), table_.end(), empty);
+  }
+
+  size_t hits, misses;
+
+  static const size_t default_bits = 10;
+
+ private:
+  // a multiplicative hash of the packed words, much cheaper than Kmer::hash
+  size_t index(const Kmer& km) const {
+    uint64_t h = 0;
+    for (size_t i = 0; i < Kmer::MAX_K/32; i++) {
+      h = (h ^ km.longs[i]) * 0x9E3779B97F4A7C15ULL;
+    }
+    return h >> shift_; // the top bits are the best mixed
+  }
+
+  struct Entry {
+    Kmer km;
+    bool present;
+  };
+
+  std::vector<Entry> table_;
+  size_t shift_;
+};
+
+#endif // BFG_BLOOMFILTER_CACHE_HPP
@@ -20,36 +20,25 @@
 #include "CompressedSequence.hpp"
 #include "Contig.hpp"
 #include "BlockedBloomFilter.hpp"
+#include "ReadNormalizer.hpp"
+#include "DuplicateSet.hpp"
 #include "ContigMethods.hpp"
 #include "KmerIterator.hpp"
 #include "fastq.hpp"
 #include "ContigMapper.hpp"
 #include "KmerHashTable.h"
+#include "ReadCache.hpp"
+#include "BuildContigs.hpp"
 
 
-struct BuildContigs_ProgramOptions {
-  bool verbose;
-  size_t threads, k;
-  string freads, output, graphfilename;
-  size_t stride;
-  bool stride_set;
-  size_t read_chunksize;
-  size_t contig_size; // not configurable
-  vector<string> files;
-  bool clipTips;
-  bool deleteIsolated;
-  BuildContigs_ProgramOptions() : verbose(false), threads(1), k(0), stride(0), stride_set(false), \
-    read_chunksize(1000), contig_size(1000000), clipTips(true), \
-    deleteIsolated(true) {}
-};
-
 // use:  BuildContigs_PrintUsage();
 // pre:
 // post: Information about the correct parameters to build contigs has been printed to cerr
 void BuildContigs_PrintUsage() {
   cout << endl << "BFGraph " << BFG_VERSION << endl;
   cout << "Creates contigs from filtered fasta/fastq files and saves results" << endl << endl;
-  cout << "Usage: BFGraph contigs [options] ... FASTQ files";
+  cout << "Usage: BFGraph contigs [options] ... FASTQ files" << endl;
+  cout << "       BFGraph contigs --from-kmers=FILE [options] ... [FASTQ files]";
   cout << endl << endl << "Options:" << endl <<
        "  -v, --verbose               Print lots of messages during run" << endl <<
        "  -t, --threads=INT           Number of threads to use (default 1)" << endl <<
@@ -57,9 +46,27 @@ void BuildContigs_PrintUsage() {
        "  -k, --kmer-size=INT         Size of k-mers, at most " << (int) (Kmer::MAX_K-1)<< endl <<
        "  -f, --filtered=STRING       File with filtered reads" << endl <<
        "  -o, --output=STRING         Prefix for output files" << endl <<
-       "  -s, --stride=INT            Distance between saved kmers when mapping (default is kmer-size)" << endl <<
+       "  -s, --stride=INT|auto       Distance between saved kmers when mapping (default is kmer-size)," << endl <<
+       "                              auto picks the smallest stride that fits in --index-memory" << endl <<
+       "      --index-memory=INT      Memory in MB for saved kmers with --stride=auto (default: size of the bloom filter)" << endl <<
        "      --no-clip-tips          Do not clip short tips, less than k k-mers in length (default: true)" << endl <<
-       "      --no-del-isolated=BOOL  Do not deleted isolated contigs shorter than k k-mers (default: true)"
+       "      --no-del-isolated=BOOL  Do not deleted isolated contigs shorter than k k-mers (default: true)" << endl <<
+       "      --count-coverage        Keep exact k-mer coverage so split contigs get real XC values (uses more memory)" << endl <<
+       "      --store-short           Keep the sequences of short contigs so they are not walked again after mapping" << endl <<
+       "                              (uses more memory, the amount is printed with --verbose)" << endl <<
+       "      --from-kmers=FILE       Build the contigs from the k-mers in a fasta/fastq file of solid k-mers or sequences," << endl <<
+       "                              reads are then optional and only used for coverage (can be given more than once)" << endl <<
+       "      --min-qual=INT          Mask bases with a lower Phred quality as N, use the value given to filter (default: 0, off)" << endl <<
+       "      --quality-scale=INT     Offset of the quality characters, 33 or 64 (default: guessed from the reads)" << endl <<
+       "      --norm-cov=INT          Map only reads whose median k-mer count in the reads mapped so far is below INT," << endl <<
+       "                              at most 255 (default: 0, all reads)" << endl <<
+       "      --norm-memory=INT       Memory in MB for the k-mer counts of --norm-cov (default: size of the bloom filter)" << endl <<
+       "      --dedup                 Map only the first copy of exact duplicate reads, the other copies are not mapped" << endl <<
+       "      --dedup-memory=INT      Memory in MB for the read fingerprints of --dedup (default: enough for the reads," << endl <<
+       "                              estimated from the file sizes)" << endl <<
+       "      --max-memory=INT        Memory in MB for the bloom filter, the contigs and the saved kmers, raises the stride" << endl <<
+       "                              when the saved kmers do not fit and stops before the run if the rest needs more" << endl <<
+       "                              (default: 0, no limit)"
        << endl << endl;
 }
 
@@ -69,7 +76,7 @@ void BuildContigs_PrintUsage() {
 //       like BuildContigs_PrintUsage describes and opt is ready to contain the parsed parameters
 // post: All the parameters from argv have been parsed into opt
 void BuildContigs_ParseOptions(int argc, char **argv, BuildContigs_ProgramOptions& opt) {
-  const char *opt_string = "vt:k:f:o:c:s:nd";
+  const char *opt_string = "vt:k:f:o:c:s:ndxI:SK:Q:q:C:M:DE:m:";
   static struct option long_options[] = {
     {"verbose",    no_argument,       0, 'v'},
     {"threads",    required_argument, 0, 't'},
@@ -80,6 +87,17 @@ void BuildContigs_ParseOptions(int argc, char **argv, BuildContigs_ProgramOption
     {"stride",     required_argument, 0, 's'},
     {"no-clip-tips",  optional_argument, 0, 'n'},
     {"no-del-isolated", optional_argument, 0, 'd'},
+    {"count-coverage", no_argument,   0, 'x'},
+    {"index-memory", required_argument, 0, 'I'},
+    {"store-short", no_argument,      0, 'S'},
+    {"from-kmers", required_argument, 0, 'K'},
+    {"min-qual",   required_argument, 0, 'Q'},
+    {"quality-scale", required_argument, 0, 'q'},
+    {"norm-cov",   required_argument, 0, 'C'},
+    {"norm-memory", required_argument, 0, 'M'},
+    {"dedup",      no_argument,       0, 'D'},
+    {"dedup-memory", required_argument, 0, 'E'},
+    {"max-memory", required_argument, 0, 'm'},
     {0,            0,                 0,  0 }
   };
 
@@ -107,7 +125,11 @@ void BuildContigs_ParseOptions(int argc, char **argv, BuildContigs_ProgramOption
       opt.read_chunksize = atoi(optarg);
       break;
     case 's':
-      opt.stride = atoi(optarg);
+      if (strcmp(optarg, "auto") == 0) {
+        opt.stride_auto = true;
+      } else {
+        opt.stride = atoi(optarg);
+      }
       opt.stride_set = true;
       break;
     case 'n':
@@ -116,6 +138,39 @@ void BuildContigs_ParseOptions(int argc, char **argv, BuildContigs_ProgramOption
     case 'd':
       opt.deleteIsolated = false;
       break;
+    case 'x':
+      opt.countCoverage = true;
+      break;
+    case 'I':
+      opt.index_memory = atoi(optarg);
+      break;
+    case 'S':
+      opt.storeShort = true;
+      break;
+    case 'K':
+      opt.kmerFiles.push_back(optarg);
+      break;
+    case 'Q':
+      opt.min_qual = atoi(optarg);
+      break;
+    case 'q':
+      opt.qual_scale = atoi(optarg);
+      break;
+    case 'C':
+      opt.norm_cov = atoi(optarg);
+      break;
+    case 'M':
+      opt.norm_memory = atoi(optarg);
+      break;
+    case 'D':
+      opt.dedup = true;
+      break;
+    case 'E':
+      opt.dedup_memory = atoi(optarg);
+      break;
+    case 'm':
+      opt.max_memory = atoi(optarg);
+      break;
     default: break;
     }
   }
@@ -179,7 +234,7 @@ bool BuildContigs_CheckOptions(BuildContigs_ProgramOptions& opt) {
   }
 
   if (opt.stride_set) {
-    if (opt.stride == 0) {
+    if (opt.stride == 0 && !opt.stride_auto) {
       cerr << "Error: Invalid stride " << opt.stride << ", need a number >= 1" << endl;
       ret = false;
     }
@@ -187,7 +242,7 @@ bool BuildContigs_CheckOptions(BuildContigs_ProgramOptions& opt) {
     opt.stride = opt.k;
   }
 
-  if (opt.files.size() == 0) {
+  if (opt.files.size() == 0 && opt.kmerFiles.size() == 0) {
     cerr << "Error: Missing fasta/fastq input files" << endl;
     ret = false;
   } else {
@@ -201,6 +256,27 @@ bool BuildContigs_CheckOptions(BuildContigs_ProgramOptions& opt) {
         ret = false;
       }
     }
+    for(it = opt.kmerFiles.begin(); it != opt.kmerFiles.end(); ++it) {
+      intStat = stat(it->c_str(), &stFileInfo);
+      if (intStat != 0) {
+        cerr << "Error: File not found, " << *it << endl;
+        ret = false;
+      }
+    }
+  }
+
+  if (opt.countCoverage && opt.files.size() == 0) {
+    cerr << "Error: --count-coverage needs reads, only k-mer files were given" << endl;
+    ret = false;
+  }
+
+  if (opt.min_qual > 0 && ret && !CheckQualityScale(opt.files, opt.min_qual, opt.qual_scale, opt.verbose)) {
+    ret = false;
+  }
+
+  if (opt.norm_cov > 255) {
+    cerr << "Error: Invalid norm-cov: " << opt.norm_cov << ", the counts stop at 255" << endl;
+    ret = false;
   }
 
   return ret;
@@ -213,33 +289,91 @@ bool BuildContigs_CheckOptions(BuildContigs_ProgramOptions& opt) {
 void BuildContigs_PrintSummary(const BuildContigs_ProgramOptions& opt) {
   cerr << "Kmer size: " << opt.k << endl
        << "Chunksize: " << opt.read_chunksize << endl
-       << "Stride: " << opt.stride << endl
-       << "Reading file with filtered reads: " << opt.freads << endl
-       << "fasta/fastq files: " << endl;
+       << "Stride: " << (opt.stride_auto ? string("auto") : to_string(opt.stride)) << endl
+       << "Reading file with filtered reads: " << opt.freads << endl;
+  if (opt.min_qual > 0) {
+    cerr << "Masking bases with quality below " << opt.min_qual << " (quality scale " << opt.qual_scale << ")" << endl;
+  }
+  if (opt.norm_cov > 0) {
+    cerr << "Normalizing to k-mer coverage " << opt.norm_cov << endl;
+  }
+  if (opt.dedup) {
+    cerr << "Skipping duplicate reads" << endl;
+  }
   vector<string>::const_iterator it;
+  if (!opt.kmerFiles.empty()) {
+    cerr << "k-mer files: " << endl;
+    for (it = opt.kmerFiles.begin(); it != opt.kmerFiles.end(); ++it) {
+      cerr << "  " << *it << endl;
+    }
+  }
+  cerr << "fasta/fastq files: " << endl;
   for (it = opt.files.begin(); it != opt.files.end(); ++it) {
     cerr << "  " << *it << endl;
   }
 }
 
-// use:  printeMemoryUsage(bf, mapper);
-// post: The memory usage of bf and mapper has been printed to cerr
-void printMemoryUsage(BlockedBloomFilter& bf, ContigMapper& cmap) {
-  size_t total = 0;
+// use:  printeMemoryUsage(bfmemory, mapper);
+// pre:  bfmemory is the memory the bloom filter used
+// post: The memory usage of the bloom filter and every part of mapper has been printed to cerr
+void printMemoryUsage(size_t bfmemory, const ContigMapper& cmap) {
+  size_t total = bfmemory + cmap.memory();
   cerr << "   -----  Memory usage  -----   " << endl;
-  total += bf.memory();
-  //total += cmap.memory(); //TODO add this method
-  total >>= 20;
-  cerr << "Total:\t\t\t" << total << "MB" << endl << endl;
+  cerr << "BlockedBloomFilter:\t" << (bfmemory >> 20) << "MB" << endl;
+  cerr << "Long contigs:\t\t" << (cmap.longContigMemory() >> 20) << "MB" << endl;
+  cerr << "Short contigs:\t\t" << (cmap.shortContigMemory() >> 20) << "MB" << endl;
+  cerr << "Saved kmers:\t\t" << (cmap.shortcutMemory() >> 20) << "MB" << endl;
+  cerr << "Short sequences:\t" << (cmap.shortSequenceMemory() >> 20) << "MB" << endl;
+  cerr << "Total:\t\t\t" << (total >> 20) << "MB" << endl;
+  cerr << "Large tables on " << largePageSummary() << endl << endl;
+}
+
+// use:  n = readSpan(seq, dist, strand, read, pos);
+// pre:  read[pos,...,pos+k-1] is the k-mer at position dist in seq if strand
+//       is true, else its twin is
+// post: n is the number of consecutive k-mers of read, starting at pos, that are in seq
+static size_t readSpan(const string& seq, size_t dist, bool strand, const string& read, size_t pos) {
+  size_t k = Kmer::k;
+  CompressedSequence cs(seq);
+  if (strand) {
+    return cs.jump(read.c_str(), pos, dist, false) - k + 1;
+  }
+  return cs.jump(read.c_str(), pos, dist + k - 1, true) - k + 1;
 }
 
 // use:  BuildContigs_Normal(opt);
 // pre:  opt has information about Kmer size, input file and output file
 // post: The contigs have been written to the output file
 void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
+  BlockedBloomFilter bf;
+  FILE *f = fopen(opt.freads.c_str(), "rb");
+  if (f == NULL) {
+    cerr << "Error, could not open file " << opt.freads << endl;
+    exit(1);
+  }
+
+  if (!bf.ReadBloomFilter(f)) {
+    cerr << "Error reading bloom filter from file " << opt.freads << endl;
+    fclose(f);
+    f = NULL;
+    exit(1);
+  } else {
+    fclose(f);
+    f = NULL;
+  }
+
+  BuildContigs_Graph(opt, bf, NULL);
+}
+
+
+// use:  BuildContigs_Graph(opt, bf, cache);
+// pre:  opt has information about Kmer size, input files and output file,
+//       bf is the filter of solid k-mers, cache is NULL or holds the reads of opt.files
+// post: The contigs have been written to the output file, bf has been cleared,
+//       the reads were streamed from cache if it is not NULL
+void BuildContigs_Graph(const BuildContigs_ProgramOptions& opt, BlockedBloomFilter& bf, ReadCache *cache) {
   /**
    *  outline of algorithm:
-   *  open bloom filter file
    *    create contig datastructures
    *    for each read
    *      for all kmers in read
@@ -253,31 +387,47 @@ void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
    *            when the contig is ready,
    *            try to jump over as many kmers as possible
    */
-  
-  BlockedBloomFilter bf;
-  FILE *f = fopen(opt.freads.c_str(), "rb");
-  if (f == NULL) {
-    cerr << "Error, could not open file " << opt.freads << endl;
-    exit(1);
-  }
 
-  if (!bf.ReadBloomFilter(f)) {
-    cerr << "Error reading bloom filter from file " << opt.freads << endl;
-    fclose(f);
-    f = NULL;
-    exit(1);
-  } else {
-    fclose(f);
-    f = NULL;
+  size_t bfmemory = bf.memory();
+  size_t norm_bytes = (opt.norm_cov == 0) ? 0 : (opt.norm_memory > 0) ? (opt.norm_memory << 20) : bf.bits() / 8;
+  size_t dedup_bytes = !opt.dedup ? 0 : (opt.dedup_memory > 0) ? (opt.dedup_memory << 20) : DuplicateSet::bytesForFiles(opt.files);
+  size_t stride = opt.stride;
+  size_t nkmers = (opt.stride_auto || opt.max_memory > 0) ? bf.count() : 0;
+  size_t budget = (opt.index_memory > 0) ? (opt.index_memory << 20) : bfmemory;
+  if (opt.max_memory > 0) {
+    // the filter, the sketches and the contigs come first, the saved kmers get what is left
+    size_t fixed = bfmemory + norm_bytes + dedup_bytes + ContigMapper::memoryForKmers(nkmers, opt.countCoverage, opt.storeShort);
+    if (fixed >= (opt.max_memory << 20)) {
+      cerr << "Error: The bloom filter and the contigs of about " << nkmers << " k-mers need about "
+           << (fixed >> 20) + 1 << " MB, more than --max-memory " << opt.max_memory << endl;
+      exit(1);
+    }
+    size_t left = (opt.max_memory << 20) - fixed;
+    budget = (opt.index_memory > 0) ? min(budget, left) : left;
+    if (!opt.stride_auto && ContigMapper::strideForMemory(nkmers, budget) > stride) {
+      // fewer saved kmers are slower to map to but keep the run in its budget
+      stride = ContigMapper::strideForMemory(nkmers, budget);
+      cerr << "Warning: Raising the stride to " << stride << " so the saved kmers fit in --max-memory" << endl;
+    }
+  }
+  if (opt.stride_auto) {
+    stride = ContigMapper::strideForMemory(nkmers, budget);
+    if (opt.verbose) {
+      cerr << "Picked stride " << stride << " for about " << nkmers << " k-mers and "
+           << (budget >> 20) << " MB of saved kmers" << endl;
+    }
   }
 
   ContigMapper cmap;
-  // stride hasn't been fully tested, don't set it
-  // cmap.setStride(opt.stride);
+  cmap.setStride(stride);
+  cmap.setCountCoverage(opt.countCoverage);
+  cmap.setStoreShortSequences(opt.storeShort);
+  if (opt.max_memory > 0) {
+    cmap.reserve(nkmers);
+  }
   cmap.mapBloomFilter(&bf);
 
   KmerIterator iter, iterend;
-  FastqFile FQ(opt.files);
 
   char name[8192];
   string s;
@@ -292,10 +442,13 @@ void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
     cerr << "Starting real work ....." << endl << endl;
   }
 
-  // Main worker thread
+  // Main worker thread, cover is false when the contigs are built from k-mer files
   auto worker_function = [&](vector<string>::const_iterator a,
                              vector<string>::const_iterator b,
-                             vector<NewContig>* smallv) {
+                             vector<NewContig>* smallv,
+                             CoverageBuffer* covbuf,
+                             BloomFilterCache* bfcache,
+                             bool cover) {
     // for each input
     for (auto x = a; x != b; ++x) {
       KmerIterator iter, iterend;
@@ -308,12 +461,12 @@ void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
       }
 
       while (iter != iterend) {
-        if (!bf.contains(rep)) { // km is not in the graph
+        if (!bfcache->contains(bf, rep)) { // km is not in the graph
           // jump over it
           iter.raise(km, rep);
         } else {
           // find mapping contig
-          ContigMap cm = cmap.findContig(km, *x, iter->second);
+          ContigMap cm = cmap.findContig(km, *x, iter->second, bfcache);
           if (cm.isEmpty) {
             // kmer did not map,
             // push into queue for next contig generation round
@@ -325,20 +478,29 @@ void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
               add = false;
             }
             if (add) {
-              bool selfLoop = false;
+              bool selfLoop = false, strand;
+              size_t dist;
               string newseq;
-              cmap.findContigSequence(km,newseq,selfLoop);
+              cmap.findContigSequence(km,newseq,selfLoop,dist,strand,bfcache);
+              // addContig only matches the read against the new contig, so only
+              // that much of the read is kept, not a copy of every long read per contig
+              string match = x->substr(iter->second, newseq.size());
               if (selfLoop) {
                 newseq.clear(); //let addContig handle it
               } else {
-                // pass
+                // the walk stops after stride steps, but the read can skip every
+                // k-mer it shares with the new contig, addContig covers them all
+                cm.len = max(cm.len, readSpan(newseq, dist, strand, *x, iter->second));
               }
-              smallv->emplace_back(km,*x,iter->second, newseq);
+              smallv->emplace_back(km, match, 0, newseq);
             }
           }
 
-          // map the read, has no effect for newly created contigs
-          cmap.mapRead(cm);
+          // map the read, has no effect for newly created contigs,
+          // the coverage is added when the buffer is flushed after the round
+          if (cover) {
+            cmap.mapRead(cm, *covbuf);
+          }
 
           // how many k-mers in the read we can skip
           size_t jump_i = 0; // already moved one forward
@@ -352,75 +514,202 @@ void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
   };
 
   vector<vector<NewContig>> parray(opt.threads);
+  vector<CoverageBuffer> covbufs(opt.threads, CoverageBuffer(opt.threads));
+  vector<BloomFilterCache> bfcaches(opt.threads);
   int round = 0;
-  bool done = false;
-  while (!done) {
-    readv.clear();
-    size_t reads_now = 0;
-    while (reads_now < read_chunksize) {
-      if (FQ.read_next(name, &name_len, s, &len, NULL, NULL) >= 0) {
-        readv.emplace_back(s);
-        ++n_read;
-        ++reads_now;
-      } else {
-        done = true;
-        break;
+
+  // map every sequence from next_read in rounds, new contigs are added at the end of each round,
+  // two threads that find the same new contig both queue it and addContig keeps the first
+  auto map_reads = [&](function<bool(string&)> next_read, bool cover) {
+    // use:  more = read_chunk(v);
+    // post: v holds the reads of the next round, more is false if there are no more
+    auto read_chunk = [&](vector<string>& v) {
+      v.clear();
+      size_t reads_now = 0;
+      while (reads_now < read_chunksize) {
+        if (next_read(s)) {
+          ++n_read;
+          ++reads_now;
+          if (splitWindows(v, s, opt.k) > 1) {
+            break; // a long record fills the round
+          }
+        } else {
+          return false;
+        }
       }
-    }
-    ++round;
+      return true;
+    };
 
-    if (read_chunksize > 1 && opt.verbose) {
-      cerr << "starting round " << round << endl;
-    }
+    vector<string> nextv;
+    bool done = !read_chunk(readv);
+    while (!readv.empty()) {
+      ++round;
 
-    // run parallel code
-    vector<thread> workers;
-    auto rit = readv.begin();
-    size_t batch_size = readv.size() / opt.threads;
-    size_t leftover   = readv.size() % opt.threads;
-    for (size_t i = 0; i < opt.threads; i++) {
-      size_t jump = batch_size + ((i < leftover ) ? 1 : 0);
-      auto rit_end(rit);
-      advance(rit_end, jump);
-      workers.push_back(thread(worker_function, rit, rit_end, &parray[i]));
-      rit = rit_end;
-    }
+      if (read_chunksize > 1 && opt.verbose) {
+        cerr << "starting round " << round << endl;
+      }
 
-    assert(rit == readv.end());
-    //assert(cmap.checkShortcuts());
+      // run parallel code
+      vector<thread> workers;
+      auto rit = readv.begin();
+      vector<size_t> ends = balanceBases(readv, opt.threads);
+      for (size_t i = 0; i < opt.threads; i++) {
+        auto rit_end = readv.begin() + ends[i];
+        workers.push_back(thread(worker_function, rit, rit_end, &parray[i], &covbufs[i], &bfcaches[i], cover));
+        rit = rit_end;
+      }
 
-    for (auto& t : workers) {
-      t.join();
-    }
-    //cmap.printState();
-
-    //assert(cmap.checkShortcuts());
-
-    // -- this part is serial
-    // for each thread
-    for (auto &v : parray) {
-      // for each new contig
-      for (auto &x : v) {
-        // add the contig
-        cmap.addContig(x.km, x.read, x.pos, x.seq);
-        //cmap.printState();
+      assert(rit == readv.end());
+      //assert(cmap.checkShortcuts());
+
+      // the reads of the next round are read while the workers map these
+      nextv.clear();
+      if (!done) {
+        done = !read_chunk(nextv);
       }
-      // clear the map
-      v.clear();
+
+      for (auto& t : workers) {
+        t.join();
+      }
+
+      // add the buffered coverage, each thread flushes its own part of the contigs
+      // before new contigs are added and the hash tables can move
+      workers.clear();
+      for (size_t i = 0; i < opt.threads; i++) {
+        workers.push_back(thread([&cmap, &covbufs, i] { cmap.flushCoverage(covbufs, i); }));
+      }
+      for (auto& t : workers) {
+        t.join();
+      }
+      for (auto& buf : covbufs) {
+        buf.clear();
+      }
+      //cmap.printState();
+
+      //assert(cmap.checkShortcuts());
+
+      // -- this part is serial
+      // for each thread
+      for (auto &v : parray) {
+        // for each new contig
+        for (auto &x : v) {
+          // add the contig
+          cmap.addContig(x.km, x.read, x.pos, x.seq, cover);
+          //cmap.printState();
+        }
+        // clear the map
+        v.clear();
+      }
+      //cmap.printState();
+
+      //assert(cmap.checkShortcuts());
+
+      if (read_chunksize > 1 && opt.verbose ) {
+        cerr << " end of round" << endl;
+        cerr << " processed " << cmap.contigCount() << " contigs" << endl;
+      }
+      readv.swap(nextv);
     }
-    //cmap.printState();
+  };
 
-    //assert(cmap.checkShortcuts());
+  // map every sequence in files, low quality bases of the reads are masked
+  auto map_files = [&](const vector<string>& files, bool cover, char min_qual) {
+    FastqFile FQ(files, opt.threads, 1, min_qual);
+    map_reads([&](string& seq) {
+      int r = FQ.read_next(name, &name_len, seq, &len, NULL, NULL);
+      if (r == -3) {
+        exit(1); // a corrupt input file, it has been reported
+      }
+      return r >= 0;
+    }, cover);
+    FQ.close();
+  };
 
-    if (read_chunksize > 1 && opt.verbose ) {
-      cerr << " end of round" << endl;
-      cerr << " processed " << cmap.contigCount() << " contigs" << endl;
+  if (!opt.kmerFiles.empty()) {
+    // the unitigs are walked from the k-mers alone, the reads only add coverage
+    map_files(opt.kmerFiles, false, 0);
+    if (opt.verbose) {
+      cerr << "Built " << cmap.contigCount() << " contigs from " << n_read << " k-mer sequences" << endl;
     }
+    n_read = 0;
+    if (opt.files.empty()) {
+      cmap.coverAll();
+    }
+  }
+  if (cache != NULL) {
+    if (!cache->rewind()) {
+      cerr << "Error reading the read cache" << endl;
+      exit(1);
+    }
+    map_reads([cache](string& seq) {
+      int r = cache->read_next(seq);
+      if (r < -1) {
+        cerr << "Error reading the read cache" << endl;
+        exit(1);
+      }
+      return r >= 0;
+    }, true);
+  } else if (!opt.files.empty() && (opt.norm_cov > 0 || opt.dedup)) {
+    // duplicates and reads past the coverage are skipped as they are read, on the main thread
+    ReadNormalizer *norm = NULL;
+    DuplicateSet *dups = NULL;
+    if (opt.norm_cov > 0) {
+      norm = new ReadNormalizer(norm_bytes, opt.norm_cov, 0);
+    }
+    if (opt.dedup) {
+      dups = new DuplicateSet(dedup_bytes);
+    }
+    string dupbuf;
+    FastqFile FQ(opt.files, opt.threads, 1, (opt.min_qual > 0) ? (char) (opt.qual_scale + opt.min_qual) : 0);
+    map_reads([&](string& seq) {
+      int r;
+      while ((r = FQ.read_next(name, &name_len, seq, &len, NULL, NULL)) >= 0) {
+        if (dups != NULL && dups->add(seq.c_str(), seq.size(), dupbuf) > 0) {
+          continue;
+        }
+        if (norm == NULL || norm->keep(seq)) {
+          return true;
+        }
+      }
+      if (r == -3) {
+        exit(1); // a corrupt input file, it has been reported
+      }
+      return false;
+    }, true);
+    FQ.close();
+    if (opt.verbose && norm != NULL) {
+      cerr << "Normalization kept " << norm->kept() << " of " << norm->reads() << " reads" << endl;
+    }
+    if (opt.verbose && dups != NULL) {
+      cerr << "Duplicates: " << dups->duplicates() << " of " << dups->reads() << " reads ("
+           << (100.0 * dups->duplicates()) / max<size_t>(dups->reads(), 1) << "%)";
+      if (dups->full()) {
+        cerr << ", the fingerprint table filled up, increase --dedup-memory";
+      }
+      cerr << endl;
+    }
+    delete norm;
+    delete dups;
+  } else if (!opt.files.empty()) {
+    map_files(opt.files, true, (opt.min_qual > 0) ? (char) (opt.qual_scale + opt.min_qual) : 0);
   }
-  FQ.close();
   parray.clear();
 
   if (opt.verbose) {
+    size_t hits = 0, misses = 0;
+    for (auto& c : bfcaches) {
+      hits += c.hits;
+      misses += c.misses;
+    }
+    cerr << "Bloom filter cache: " << hits << " hits, " << misses << " misses";
+    if (hits + misses > 0) {
+      cerr << " (" << (100.0 * hits) / (hits + misses) << "% hit rate)";
+    }
+    cerr << endl;
+    if (opt.storeShort) {
+      cerr << "Short contig sequences: " << cmap.shortSequenceCount() << " contigs, "
+           << (cmap.shortSequenceMemory() >> 10) << " KB" << endl;
+    }
     cerr << "Closed all fasta/fastq files" << endl;
     cerr << "Splitting contigs" << endl;
   }
@@ -503,7 +792,7 @@ void BuildContigs_Normal(const BuildContigs_ProgramOptions& opt) {
 
   if (opt.verbose) {
     cerr << "Number of reads " << n_read  << ", kmers stored " << 0 << endl << endl;
-    printMemoryUsage(bf, cmap);
+    printMemoryUsage(bfmemory, cmap);
     cerr << "Writing the graph to file: " << opt.graphfilename << endl;
 
   }
@@ -1,9 +1,47 @@
 #ifndef BFG_BUILD_CONTIGS
 #define BFG_BUILD_CONTIGS
 
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+
+class BlockedBloomFilter;
+class ReadCache;
+
+
+struct BuildContigs_ProgramOptions {
+  bool verbose;
+  size_t threads, k;
+  string freads, output, graphfilename;
+  size_t stride;
+  bool stride_set;
+  bool stride_auto;
+  size_t index_memory; // MB for the shortcut table when the stride is picked automatically
+  size_t read_chunksize;
+  size_t contig_size; // not configurable
+  vector<string> files;
+  bool clipTips;
+  bool deleteIsolated;
+  bool countCoverage;
+  bool storeShort;
+  vector<string> kmerFiles; // seeds for building the contigs without reads
+  size_t min_qual, qual_scale; // bases below min_qual are masked, scale 0 is guessed
+  size_t norm_cov, norm_memory; // digital normalization coverage, 0 for none, and sketch MB
+  bool dedup; // exact duplicate reads are not mapped
+  size_t dedup_memory; // MB for the read fingerprints, 0 for the default
+  size_t max_memory; // MB the filter, the contigs and the saved k-mers must fit in, 0 for no limit
+  BuildContigs_ProgramOptions() : verbose(false), threads(1), k(0), stride(0), stride_set(false), stride_auto(false), index_memory(0), \
+    read_chunksize(1000), contig_size(1000000), clipTips(true), \
+    deleteIsolated(true), countCoverage(false), storeShort(false), min_qual(0), qual_scale(0), \
+    norm_cov(0), norm_memory(0), dedup(false), dedup_memory(0), max_memory(0) {}
+};
+
+
 /* Short description:
  *  - Create contigs from kmers in reads by using bloom filters
  * */
 void BuildContigs(int argc, char **argv);
+void BuildContigs_Graph(const BuildContigs_ProgramOptions& opt, BlockedBloomFilter& bf, ReadCache *cache);
 
 #endif // BFG_BUILD_CONTIGS
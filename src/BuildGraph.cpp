@@ -0,0 +1,377 @@
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+#include <thread>
+
+#include "Common.hpp"
+#include "BuildGraph.hpp"
+#include "FilterReads.hpp"
+#include "BuildContigs.hpp"
+#include "BlockedBloomFilter.hpp"
+#include "ReadCache.hpp"
+#include "fastq.hpp"
+#include "Kmer.hpp"
+
+
+struct BuildGraph_ProgramOptions {
+  FilterReads_ProgramOptions filter;
+  BuildContigs_ProgramOptions contigs;
+  string cachefile;
+  BuildGraph_ProgramOptions() {}
+};
+
+// use:  BuildGraph_PrintUsage();
+// pre:
+// post: Information about how to build the graph in one run has been printed to cout
+void BuildGraph_PrintUsage() {
+  cout << endl << "BFGraph " << BFG_VERSION << endl;
+  cout << "Filters the reads and builds the contig graph in one run, the reads are only parsed once" << endl << endl;
+  cout << "Usage: BFGraph build [options] ... FASTQ files";
+  cout << endl << endl << "Options:" << endl <<
+       "  -v, --verbose               Print lots of messages during run" << endl <<
+       "  -t, --threads=INT           Number of threads to use (default 1)" << endl <<
+       "  -c, --chunk-size=INT        Read chunksize to split betweeen threads (default 10000 when filtering, 1000 for contigs)" << endl <<
+       "  -k, --kmer-size=INT         Size of k-mers, at most " << (int) (Kmer::MAX_K-1) << endl <<
+       "  -n, --num-kmers=LONG        Estimated number of k-mers (upper bound)" << endl <<
+       "  -N, --num-kmer2=LONG        Estimated number of k-mers in genome (upper bound)" << endl <<
+       "  -b, --bloom-bits=INT        Number of bits to use in Bloom filter (default=4)" << endl <<
+       "  -B, --bloom-bits2=INT       Number of bits to use in second Bloom filter (default=8)" << endl <<
+       "      --seed=INT              Seed used for randomization (default time based)" << endl <<
+       "  -o, --output=STRING         Prefix for output files" << endl <<
+       "  -s, --stride=INT|auto       Distance between saved kmers when mapping (default is kmer-size)," << endl <<
+       "                              auto picks the smallest stride that fits in --index-memory" << endl <<
+       "      --index-memory=INT      Memory in MB for saved kmers with --stride=auto (default: size of the bloom filter)" << endl <<
+       "      --no-clip-tips          Do not clip short tips, less than k k-mers in length (default: true)" << endl <<
+       "      --no-del-isolated       Do not deleted isolated contigs shorter than k k-mers (default: true)" << endl <<
+       "      --count-coverage        Keep exact k-mer coverage so split contigs get real XC values (uses more memory)" << endl <<
+       "      --store-short           Keep the sequences of short contigs so they are not walked again after mapping" << endl <<
+       "      --read-cache=STRING     Temporary file for the packed reads, about a quarter of the" << endl <<
+       "                              uncompressed reads (default: output prefix + .reads.tmp)" << endl <<
+       "      --min-qual=INT          Mask bases with a lower Phred quality as N, no k-mer covers them (default: 0, off)" << endl <<
+       "      --quality-scale=INT     Offset of the quality characters, 33 or 64 (default: guessed from the reads)" << endl <<
+       "      --norm-cov=INT          Drop reads whose median k-mer count in the reads kept so far is INT or more, at most 255 (default: 0, off)," << endl <<
+       "                              the contigs are then built and covered from the kept reads only" << endl <<
+       "      --norm-memory=INT       Memory in MB for the k-mer counts of --norm-cov (default: 1 byte per k-mer of num-kmers)" << endl <<
+       "      --norm-out=STRING       Write the reads kept by --norm-cov to this fasta file" << endl <<
+       "      --dedup                 Filter exact duplicate reads through the second filter only and do not map them" << endl <<
+       "      --dedup-memory=INT      Memory in MB for the read fingerprints of --dedup (default: enough for the reads, estimated from the file sizes)" << endl <<
+       "      --max-fpr=FLOAT         Stop when the false positive rate of a filter passes FLOAT and print the size it needs" << endl <<
+       "                              (default: 0, only warn when it passes 4 times the rate it was sized for)" << endl <<
+       "      --max-memory=INT        Memory in MB for each step, picks num-kmers and num-kmers2 when they are not given," << endl <<
+       "                              raises the stride when the saved kmers do not fit and stops before a step that" << endl <<
+       "                              needs more (default: 0, no limit)" << endl <<
+       "      --partitioned           Buffer the k-mers of each thread and insert them into one 2MB part of the filters" << endl <<
+       "                              at a time, faster when the filters are much larger than the CPU cache"
+       << endl << endl;
+}
+
+
+// use:  BuildGraph_ParseOptions(argc, argv, opt);
+// pre:  argc is the parameter count, argv is a list of valid parameters
+//       like BuildGraph_PrintUsage describes and opt is ready to contain the parsed parameters
+// post: All the parameters from argv have been parsed into opt
+void BuildGraph_ParseOptions(int argc, char **argv, BuildGraph_ProgramOptions& opt) {
+  const char *opt_string = "vt:c:k:n:N:b:B:o:s:";
+  static struct option long_options[] = {
+    {"verbose",         no_argument,       0, 'v'},
+    {"threads",         required_argument, 0, 't'},
+    {"chunk-size",      required_argument, 0, 'c'},
+    {"kmer-size",       required_argument, 0, 'k'},
+    {"num-kmers",       required_argument, 0, 'n'},
+    {"num-kmers2",      required_argument, 0, 'N'},
+    {"bloom-bits",      required_argument, 0, 'b'},
+    {"bloom-bits2",     required_argument, 0, 'B'},
+    {"output",          required_argument, 0, 'o'},
+    {"stride",          required_argument, 0, 's'},
+    {"seed",            required_argument, 0,  0 },
+    {"index-memory",    required_argument, 0,  0 },
+    {"no-clip-tips",    no_argument,       0,  0 },
+    {"no-del-isolated", no_argument,       0,  0 },
+    {"count-coverage",  no_argument,       0,  0 },
+    {"store-short",     no_argument,       0,  0 },
+    {"read-cache",      required_argument, 0,  0 },
+    {"min-qual",        required_argument, 0,  0 },
+    {"quality-scale",   required_argument, 0,  0 },
+    {"norm-cov",        required_argument, 0,  0 },
+    {"norm-memory",     required_argument, 0,  0 },
+    {"norm-out",        required_argument, 0,  0 },
+    {"dedup",           no_argument,       0,  0 },
+    {"dedup-memory",    required_argument, 0,  0 },
+    {"max-fpr",         required_argument, 0,  0 },
+    {"max-memory",      required_argument, 0,  0 },
+    {"partitioned",     no_argument,       0,  0 },
+    {0,                 0,                 0,  0 }
+  };
+
+  FilterReads_ProgramOptions& fopt = opt.filter;
+  BuildContigs_ProgramOptions& copt = opt.contigs;
+  int option_index = 0, c;
+  stringstream ss, ss2;
+  while ((c = getopt_long(argc, argv, opt_string, long_options, &option_index)) != -1) {
+    switch (c) {
+    case 0: {
+      const char *name = long_options[option_index].name;
+      if (strcmp(name, "seed") == 0) {
+        fopt.seed = atoi(optarg);
+      } else if (strcmp(name, "index-memory") == 0) {
+        copt.index_memory = atoi(optarg);
+      } else if (strcmp(name, "no-clip-tips") == 0) {
+        copt.clipTips = false;
+      } else if (strcmp(name, "no-del-isolated") == 0) {
+        copt.deleteIsolated = false;
+      } else if (strcmp(name, "count-coverage") == 0) {
+        copt.countCoverage = true;
+      } else if (strcmp(name, "store-short") == 0) {
+        copt.storeShort = true;
+      } else if (strcmp(name, "read-cache") == 0) {
+        opt.cachefile = optarg;
+      } else if (strcmp(name, "min-qual") == 0) {
+        fopt.min_qual = atoi(optarg);
+      } else if (strcmp(name, "quality-scale") == 0) {
+        fopt.qual_scale = atoi(optarg);
+      } else if (strcmp(name, "norm-cov") == 0) {
+        fopt.norm_cov = atoi(optarg);
+      } else if (strcmp(name, "norm-memory") == 0) {
+        fopt.norm_memory = atoi(optarg);
+      } else if (strcmp(name, "norm-out") == 0) {
+        fopt.norm_out = optarg;
+      } else if (strcmp(name, "dedup") == 0) {
+        fopt.dedup = true;
+      } else if (strcmp(name, "dedup-memory") == 0) {
+        fopt.dedup_memory = atoi(optarg);
+      } else if (strcmp(name, "max-fpr") == 0) {
+        fopt.max_fpr = atof(optarg);
+      } else if (strcmp(name, "max-memory") == 0) {
+        fopt.max_memory = copt.max_memory = atoi(optarg);
+      } else if (strcmp(name, "partitioned") == 0) {
+        fopt.partitioned = true;
+      }
+      break;
+    }
+    case 'v':
+      fopt.verbose = copt.verbose = true;
+      break;
+    case 't':
+      fopt.threads = copt.threads = atoi(optarg);
+      break;
+    case 'c':
+      fopt.read_chunksize = copt.read_chunksize = atoi(optarg);
+      break;
+    case 'k':
+      fopt.k = copt.k = atoi(optarg);
+      break;
+    case 'n':
+      ss << optarg;
+      ss >> fopt.nkmers;
+      break;
+    case 'N':
+      ss2 << optarg;
+      ss2 >> fopt.nkmers2;
+      break;
+    case 'b':
+      fopt.bf = atoi(optarg);
+      break;
+    case 'B':
+      fopt.bf2 = atoi(optarg);
+      break;
+    case 'o':
+      copt.output = optarg;
+      break;
+    case 's':
+      if (strcmp(optarg, "auto") == 0) {
+        copt.stride_auto = true;
+      } else {
+        copt.stride = atoi(optarg);
+      }
+      copt.stride_set = true;
+      break;
+    default: break;
+    }
+  }
+
+  // all other arguments are fast[a/q] files to be read
+  while (optind < argc) {
+    fopt.files.push_back(argv[optind]);
+    copt.files.push_back(argv[optind++]);
+  }
+}
+
+
+// use:  b = BuildGraph_CheckOptions(opt);
+// pre:  opt contains parameters for building the graph
+// post: (b == true)  <==>  the parameters are valid
+bool BuildGraph_CheckOptions(BuildGraph_ProgramOptions& opt) {
+  bool ret = true;
+  FilterReads_ProgramOptions& fopt = opt.filter;
+  BuildContigs_ProgramOptions& copt = opt.contigs;
+
+  size_t max_threads = std::thread::hardware_concurrency();
+
+  if (fopt.threads == 0 || fopt.threads > max_threads) {
+    cerr << "Error: Invalid number of threads " << fopt.threads;
+    if (max_threads == 1) {
+      cerr << ", can only use 1 thread on this system" << endl;
+    } else {
+      cerr << ", need a number between 1 and " << max_threads << endl;
+    }
+    ret = false;
+  }
+
+  if (fopt.read_chunksize == 0) {
+    cerr << "Error: Invalid chunk-size: " << fopt.read_chunksize
+         << ", need a number greater than 0" << endl;
+    ret = false;
+  }
+
+  if (fopt.k == 0 || fopt.k >= MAX_KMER_SIZE) {
+    cerr << "Error: Invalid kmer-size: " << fopt.k
+         << ", need a number between 1 and " << (MAX_KMER_SIZE-1) << endl;
+    ret = false;
+  }
+
+  if (fopt.max_memory > 0 && !FilterReads_PlanMemory(fopt)) {
+    ret = false;
+  }
+
+  if (fopt.nkmers <= 0) {
+    cerr << "Error, invalid value for num-kmers (parameter -n): " << fopt.nkmers << endl;
+    cerr << "Values must be positive integers" << endl;
+    ret = false;
+  }
+
+  if (fopt.nkmers2 <= 0) {
+    cerr << "Error, invalid value for num-kmers2 (parameter -N):" << fopt.nkmers2 << endl;
+    cerr << "Values must be positive integers" << endl;
+    ret = false;
+  }
+
+  if (fopt.bf <= 0) {
+    cerr << "Invalid value for bloom filter size" << endl;
+    ret = false;
+  }
+
+  if (fopt.bf2 <= 0) {
+    cerr << "Invalid value for bloom filter size for second set" << endl;
+    ret = false;
+  }
+
+  if (fopt.max_fpr < 0 || fopt.max_fpr >= 1) {
+    cerr << "Error: Invalid max-fpr: " << fopt.max_fpr << ", need a number between 0 and 1" << endl;
+    ret = false;
+  }
+
+  copt.graphfilename = copt.output + ".gfa";
+  FILE *fp;
+  if ((fp = fopen(copt.graphfilename.c_str(), "w")) == NULL) {
+    cerr << "Error: Could not open file for writing: " << copt.graphfilename << endl;
+    ret = false;
+  } else {
+    fclose(fp);
+  }
+
+  if (opt.cachefile.empty()) {
+    opt.cachefile = copt.output + ".reads.tmp";
+  }
+
+  if (copt.stride_set) {
+    if (copt.stride == 0 && !copt.stride_auto) {
+      cerr << "Error: Invalid stride " << copt.stride << ", need a number >= 1" << endl;
+      ret = false;
+    }
+  } else {
+    copt.stride = copt.k;
+  }
+
+  if (fopt.files.size() == 0) {
+    cerr << "Error: Missing fasta/fastq input files" << endl;
+    ret = false;
+  } else {
+    struct stat stFileInfo;
+    vector<string>::const_iterator it;
+    for (it = fopt.files.begin(); it != fopt.files.end(); ++it) {
+      if (stat(it->c_str(), &stFileInfo) != 0) {
+        cerr << "Error: File not found, " << *it << endl;
+        ret = false;
+      }
+    }
+  }
+
+  // the reads are masked once, when they are filtered and cached
+  if (fopt.min_qual > 0 && ret && !CheckQualityScale(fopt.files, fopt.min_qual, fopt.qual_scale, fopt.verbose)) {
+    ret = false;
+  }
+
+  // the reads are normalized once too, only the kept ones are cached
+  if (!FilterReads_CheckNormalization(fopt)) {
+    ret = false;
+  }
+
+  return ret;
+}
+
+
+// use:  BuildGraph_Normal(opt);
+// pre:  opt has been checked with BuildGraph_CheckOptions
+// post: The reads have been filtered into a Bloom filter and packed into
+//       the read cache in one pass, the contigs have been built from the
+//       cache with the filter still in memory and written to the output file,
+//       the read cache has been deleted
+void BuildGraph_Normal(const BuildGraph_ProgramOptions& opt) {
+  ReadCache cache;
+  if (!cache.create(opt.cachefile)) {
+    cerr << "Error: Could not open file for writing: " << opt.cachefile << endl;
+    exit(1);
+  }
+
+  BlockedBloomFilter bf;
+  FilterReads_Filter(opt.filter, bf, &cache);
+
+  if (opt.contigs.verbose) {
+    cerr << "Read cache: " << cache.reads() << " reads, " << cache.bases() << " bases in "
+         << (cache.bytes() >> 10) << " KB" << endl;
+  }
+
+  BuildContigs_Graph(opt.contigs, bf, &cache);
+  cache.remove();
+}
+
+
+// use:  BuildGraph(argc, argv);
+// pre:  argc is the number of arguments in argv and argv includes
+//       arguments for filtering the reads and building the contigs, including filenames
+// post: If the number of arguments is correct and the arguments are valid
+//       the contigs have been built from the reads and written to a file
+void BuildGraph(int argc, char **argv) {
+
+  BuildGraph_ProgramOptions opt;
+  BuildGraph_ParseOptions(argc, argv, opt);
+
+  if (argc < 2) {
+    BuildGraph_PrintUsage();
+    exit(1);
+  }
+
+  if (!BuildGraph_CheckOptions(opt)) {
+    BuildGraph_PrintUsage();
+    exit(1);
+  }
+
+  // set static global k-value
+  Kmer::set_k(opt.filter.k);
+
+  if (opt.filter.verbose) {
+    FilterReads_PrintSummary(opt.filter);
+    cerr << "Stride: " << (opt.contigs.stride_auto ? string("auto") : to_string(opt.contigs.stride)) << endl
+         << "Read cache: " << opt.cachefile << endl;
+  }
+
+  BuildGraph_Normal(opt);
+
+}
@@ -0,0 +1,10 @@
+#ifndef BFG_BUILD_GRAPH
+#define BFG_BUILD_GRAPH
+
+/* Short description:
+ *  - Filter the reads and build the contigs in one process, the Bloom filter
+ *    stays in memory and the reads are streamed from a packed cache
+ * */
+void BuildGraph(int argc, char **argv);
+
+#endif // BFG_BUILD_GRAPH
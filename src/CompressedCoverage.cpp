@@ -53,6 +53,16 @@ void CompressedCoverage::initialize(size_t sz, bool full) {
 }
 
 
+// use:  m = cc.memory();
+// post: m is the memory used by cc in bytes, with the array on the heap if it has one
+size_t CompressedCoverage::memory() const {
+  if ((asBits & tagMask) == tagMask || (asBits & fullMask) == fullMask) {
+    return sizeof(*this);
+  }
+  return sizeof(*this) + 8 + round_to_bytes(size());
+}
+
+
 // use:  delete cc;
 // post:
 CompressedCoverage::~CompressedCoverage() {
@@ -154,7 +164,7 @@ string CompressedCoverage::toString() const {
     info << endl <<  "[";
       for (int i = 0; i < sz; i++) {
         if (i>0) { info << ", "; }
-        info << (int)covAt(i);
+        info << (full ? 2 : (int)covAt(i));
       }
       info << "] " << endl;
     
@@ -253,6 +263,66 @@ void CompressedCoverage::cover(size_t start, size_t end) {
 }
 
 
+// use:  y = saturating_add(x, m, times, nfull);
+// pre:  m has the low bit of every 2-bit counter in x that is to be changed
+// post: those counters have been increased by times, saturating at 2,
+//       nfull has been increased by the number of counters that reached 2
+static inline uint64_t saturating_add(uint64_t x, uint64_t m, size_t times, size_t& nfull) {
+  uint64_t lo = x & m, hi = (x >> 1) & m;
+  uint64_t nhi = (times >= 2) ? m : (hi | lo);
+  uint64_t nlo = (times >= 2) ? 0 : (m & ~(hi | lo));
+  nfull += __builtin_popcountll(nhi & ~hi);
+  return (x & ~(m | (m << 1))) | nlo | (nhi << 1);
+}
+
+
+// use:  m = counter_mask(a, b);
+// pre:  0 <= a <= b < 32
+// post: m has the low bit of the 2-bit counters a,...,b of a 64-bit word
+static inline uint64_t counter_mask(size_t a, size_t b) {
+  return (0x5555555555555555ULL >> (64 - 2*(b - a + 1))) << (2*a);
+}
+
+
+// use:  cc.addCoverage(start, end, times);
+// pre:  0 <= start <= end < cc.size(), no other thread changes cc
+// post: the coverage of kmers start,...,end has been increased by times,
+//       saturating at 2, a whole word of counters is updated at once
+void CompressedCoverage::addCoverage(size_t start, size_t end, size_t times) {
+  assert(start <= end);
+  assert(end < size());
+
+  if (times == 0 || isFull()) {
+    return;
+  }
+
+  size_t nfull = 0;
+  if ((asBits & tagMask) == tagMask) { // local array
+    asBits = saturating_add(asBits, counter_mask(start, end) << 8, times, nfull);
+    if (isFull()) {
+      asBits |= fullMask;
+    }
+  } else {
+    uint8_t *ptr = get8Pointer() + 8;
+    size_t nbytes = round_to_bytes(size());
+    for (size_t w = start >> 5; w <= (end >> 5); w++) {
+      size_t a = std::max(start, 32*w) - 32*w, b = std::min(end, 32*w + 31) - 32*w;
+      size_t n = std::min<size_t>(8, nbytes - 8*w);
+      uint64_t x = 0;
+      memcpy(&x, ptr + 8*w, n);
+      x = saturating_add(x, counter_mask(a, b), times, nfull);
+      memcpy(ptr + 8*w, &x, n);
+    }
+    if (nfull > 0) {
+      *(get32Pointer() + 1) -= nfull;
+    }
+    if (isFull()) {
+      releasePointer();
+    }
+  }
+}
+
+
 // use:  k = cc.covat(index);
 // pre:  0 <= index < size(), cc is not full
 // post: k is the coverage at index
@@ -268,6 +338,24 @@ uint8_t CompressedCoverage::covAt(size_t index) const {
 }
 
 
+// use:  x = cc.counterWord(w);
+// pre:  cc is not full
+// post: x holds the 2-bit counters 32*w,...,32*w+31, counters past size() are 0
+uint64_t CompressedCoverage::counterWord(size_t w) const {
+  size_t sz = size();
+  if ((asBits & tagMask) == tagMask) {
+    return (w == 0) ? ((asBits >> 8) & ((1ULL << (2*sz)) - 1)) : 0;
+  } else {
+    size_t nbytes = round_to_bytes(sz);
+    uint64_t x = 0;
+    if (8*w < nbytes) {
+      memcpy(&x, get8Pointer() + 8 + 8*w, std::min<size_t>(8, nbytes - 8*w));
+    }
+    return x;
+  }
+}
+
+
 // use:  (low, sum) = ccov.lowCoverage();
 // pre:
 // post: low is the number of kmers under coverage limtis
@@ -277,17 +365,17 @@ pair<size_t, size_t> CompressedCoverage::lowCoverageInfo() const {
   if (isFull()) {
     return make_pair(0,0);
   }
+  // counters are 0, 1 or 2, so the high bits count the full ones
+  // and the low bits sum up the rest, a word of counters at a time
   size_t sz = size();
-  size_t low = 0;
+  size_t full = 0;
   size_t sum = 0;
-  for(size_t i=0; i<sz; ++i) {
-    size_t cov = covAt(i);
-    if (cov < 2) {
-      ++low;
-      sum += cov;
-    }
+  for (size_t w = 0; 32*w < sz; ++w) {
+    uint64_t x = counterWord(w);
+    full += __builtin_popcountll((x >> 1) & 0x5555555555555555ULL);
+    sum += __builtin_popcountll(x & 0x5555555555555555ULL);
   }
-  return make_pair(low, sum);
+  return make_pair(sz - full, sum);
 }
 
 
@@ -302,20 +390,31 @@ vector<pair<int, int>> CompressedCoverage::splittingVector() const {
   size_t a = 0, b = 0, sz = size();
   vector<pair<int, int>> v;
 
+  // first counter at or after i that is full (if full is true) or not full, sz if none
+  auto next = [&](size_t i, bool full) -> size_t {
+    while (i < sz) {
+      size_t w = i >> 5;
+      uint64_t f = (counterWord(w) >> 1) & 0x5555555555555555ULL;
+      if (!full) {
+        f = ~f & 0x5555555555555555ULL;
+      }
+      f &= ~0ULL << (2*(i & 0x1F));
+      if (f != 0) {
+        return std::min(sz, 32*w + __builtin_ctzll(f)/2);
+      }
+      i = 32*(w+1);
+    }
+    return sz;
+  };
+
   while (b != sz) {
     // [a,...,b-1] is a fully covered subinterval and (a,b) has been added to v
-    while (a < sz && covAt(a) <= 1) {
-      a++;
-    }
+    a = next(b, true);
     if (a == sz) {
       break;
     }
-    b = a;
-    while (b < sz && covAt(b) > 1) {
-      b++;
-    }
+    b = next(a, false);
     v.push_back(make_pair(a,b));
-    a = b;
   }
   return v;
 }
@@ -340,6 +439,10 @@ bool CompressedCoverage::isFull() const {
 // post: cc is full and any memory is released
 void CompressedCoverage::setFull() {
   if (!isFull()) {
-    releasePointer();
+    if ((asBits & tagMask) == tagMask) {
+      asBits |= fullMask; // a local array has no memory to release
+    } else {
+      releasePointer();
+    }
   }
 }
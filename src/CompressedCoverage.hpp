@@ -35,10 +35,12 @@ class CompressedCoverage {
 
 
   void cover(size_t start, size_t end);
+  void addCoverage(size_t start, size_t end, size_t times);
 
   bool isFull() const;
   void setFull();
   size_t size() const;
+  size_t memory() const;
   uint8_t covAt(size_t index) const;
   std::string toString() const; // for debugging
 
@@ -60,6 +62,7 @@ class CompressedCoverage {
   uint32_t *get32Pointer() const { return reinterpret_cast<uint32_t *>(asBits & pointerMask); }
   const uint32_t *getConst32Pointer() const { return reinterpret_cast<const uint32_t *>(asBits & pointerMask); }
   void releasePointer();
+  uint64_t counterWord(size_t w) const;
 
   union {
     uint8_t *asPointer;
@@ -1,48 +1,31 @@
+#include <algorithm>
+#include <vector>
+
 #include "Common.hpp"
 #include "Kmer.hpp"
 #include "CompressedSequence.hpp"
-
-
-static const char bases[256] = {
-  'A','C','G','T','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N',
-  'N','N','N','N','N','N','N','N',  'N','N','N','N','N','N','N','N'
-};
-
-// bits['A'] == bits['a'] , 0
-// bits['C'] == bits['c'] , 1
-// bits['G'] == bits['g'] , 2
-// bits['T'] == bits['t'] , 3
-static const uint8_t bits[256] = {
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
-  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+#include "TwoBitCodec.hpp"
+
+
+// codes['A'] == codes['a'] == 0, ... , codes['T'] == codes['t'] == 3,
+// as in KmerIterator, every other character, including '\0', is 4
+static const uint8_t codes[256] = {
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
 };
 
 
@@ -67,6 +50,7 @@ CompressedSequence::~CompressedSequence() {
 // pre:
 // post: the DNA string in _cs and is the same as in cs
 CompressedSequence::CompressedSequence(const CompressedSequence& o) {
+  initShort();
   if (o.isShort()) {
     asBits._size = o.asBits._size;
     memcpy(asBits._arr, o.asBits._arr, 31);
@@ -80,10 +64,15 @@ CompressedSequence::CompressedSequence(const CompressedSequence& o) {
 // pre:
 // post: the DNA string in _cs is the same as in cs
 CompressedSequence& CompressedSequence::operator=(const CompressedSequence& o) {
+  if (this == &o) {
+    return *this;
+  }
   if (o.isShort()) {
+    clear(); // release any memory we had
     asBits._size = o.asBits._size;
     memcpy(asBits._arr, o.asBits._arr,31); // plain vanilla copy
   } else {
+    setSize(0);
     setSequence(o,0,o.size()); // copy sequence and pointers etc.
   }
   return *this;
@@ -125,7 +114,7 @@ const char CompressedSequence::operator[](size_t index) const {
   size_t i = index / 4;
   size_t j = index % 4;
   size_t idx = ((data[i]) >> (2*j)) & 0x03;
-  return bases[idx];
+  return alpha[idx];
 }
 
 
@@ -185,29 +174,18 @@ void CompressedSequence::setSequence(const CompressedSequence& o, size_t start,
 
   char *data = const_cast<char *>(getPointer());
   const char *odata = o.getPointer();
-
-  size_t w_index = offset;
-  size_t r_index = reversed ? o.size()-start-1 : start;
-  size_t wi,wj,ri,rj;
-
-  for (size_t i = 0; i < length; i++) {
-    wi = w_index / 4;
-    wj = w_index % 4;
-    ri = r_index / 4;
-    rj = r_index % 4;
-    data[wi] &= ~(0x03<<(2*wj)); // clear bits
-    uint8_t nucl = (odata[ri] >> (2*rj)) & 0x03; // nucleotide stored in o
-    if (reversed) {
-      nucl = 3-nucl; // reverse sequence
-    }
-    data[wi] |= (nucl << (2*wj));
-
-    w_index++;
-    if (reversed) {
-      r_index--;
+  size_t obytes = round_to_bytes(o.size());
+
+  // copy 32 bases at a time, reverse complementing whole words if needed
+  for (size_t i = 0; i < length; i += 32) {
+    size_t n = std::min<size_t>(32, length - i);
+    uint64_t w;
+    if (!reversed) {
+      w = load_bases(odata, obytes, start + i);
     } else {
-      r_index++;
+      w = ~reverse_bases(load_bases(odata, obytes, o.size() - start - i - n)) >> (2*(32-n));
     }
+    store_bases(data, offset + i, n, w);
   }
   // new length?
   if (offset + length > size()) {
@@ -265,13 +243,26 @@ void CompressedSequence::setSequence(const char *s, size_t length, size_t offset
   }
   char *data = const_cast<char *>(getPointer());
 
+  // encode s in one pass, short strings stay on the stack
+  size_t nwords = (length+31)/32, nmask = (length+63)/64;
+  uint64_t local[24];
+  vector<uint64_t> heap;
+  uint64_t *packed = local;
+  if (nwords + nmask > 24) {
+    heap.resize(nwords + nmask);
+    packed = &heap[0];
+  }
+  encodeBases(s, length, packed, packed + nwords);
 
-  for (size_t index = offset; index < offset+length; index++) {
-    size_t i = index / 4;
-    size_t j = index % 4;
-    data[i] &= ~(0x03 << (2*j)); // set bits to 0, default
-    uint8_t c = reversed ? bases[0x03-bits[(uint8_t)*(s+length+offset-index-1)]] : *(s+index-offset);
-    data[i] |= (bits[c] << (2*j));
+  for (size_t i = 0; i < length; i += 32) {
+    size_t n = std::min<size_t>(32, length - i);
+    uint64_t w;
+    if (!reversed) {
+      w = packed[i/32];
+    } else {
+      w = ~reverse_bases(load_bases((const char *) packed, 8*nwords, length - i - n)) >> (2*(32-n));
+    }
+    store_bases(data, offset + i, n, w);
   }
 
   if (offset + length > size()) {
@@ -297,9 +288,26 @@ void CompressedSequence::setSequence(const string& s, size_t length, size_t offs
 //       else: cs[offset,...,offset+length-1] is the first length characters from the
 //         reverse complement of the DNA string in km
 void CompressedSequence::setSequence(const Kmer& km, size_t length, size_t offset, bool reversed) {
-  char s[Kmer::MAX_K+1];
-  km.toString(&s[0]);
-  setSequence(s, length, offset, reversed);
+  if (reversed) {
+    char s[Kmer::MAX_K+1];
+    km.toString(&s[0]);
+    setSequence(s, length, offset, reversed);
+    return;
+  }
+
+  if (round_to_bytes(length+offset) > capacity()) {
+    _resize_and_copy(round_to_bytes(length+offset), size());
+  }
+  char *data = const_cast<char *>(getPointer());
+
+  // the k-mer stores its first base in the top bits of each word
+  for (size_t l = 0; 32*l < length; l++) {
+    store_bases(data, offset + 32*l, std::min<size_t>(32, length - 32*l), reverse_bases(km.longs[l]));
+  }
+
+  if (offset + length > size()) {
+    setSize(offset + length);
+  }
 }
 
 
@@ -315,15 +323,10 @@ string CompressedSequence::toString() const {
 // pre:  offset + length <= cs.size(),
 // post: s is the DNA string from c[offset,...,offset+length-1]
 string CompressedSequence::toString(size_t offset, size_t length) const {
-  const char *data = getPointer();
   assert(offset+length <= size());
   string s(length,0);
-  size_t i,j,idx;
-  for (size_t index = offset; index < offset+length; index++) {
-    i = index / 4;
-    j = index % 4;
-    idx = ((data[i]) >> (2*j)) & 0x03;
-    s[index-offset] = bases[idx];
+  if (length > 0) {
+    decodeBases(getPointer(), offset, length, &s[0]);
   }
   return s;
 }
@@ -342,15 +345,8 @@ void CompressedSequence::toString(char *s) const {
 //       s has space for length characters
 // post: s is the same as cs[offset,...,offset+length-1]
 void CompressedSequence::toString(char *s, size_t offset, size_t length) const {
-  const char *data = getPointer();
   assert(offset+length <= size());
-  size_t i,j,idx;
-  for (size_t index = offset; index < offset+length; index++) {
-    i = index / 4;
-    j = index % 4;
-    idx = ((data[i]) >> (2*j)) & 0x03;
-    s[index-offset] = bases[idx];
-  }
+  decodeBases(getPointer(), offset, length, s);
   s[length] = 0; // 0-terminated string
 }
 
@@ -359,9 +355,29 @@ void CompressedSequence::toString(char *s, size_t offset, size_t length) const {
 // pre:  offset + Kmer::k <= cs._length
 // post: The DNA string in km is cs[offset,...,offset+Kmer::k-1]
 Kmer CompressedSequence::getKmer(size_t offset) const {
-  char s[Kmer::MAX_K+1];
-  toString(&s[0], offset, Kmer::k);
-  return Kmer(s);
+  assert(offset + Kmer::k <= size());
+  Kmer km;
+  km.set_packed(getPointer(), round_to_bytes(size()), offset);
+  return km;
+}
+
+
+// use:  sub = cs.subSequence(start, length);
+// pre:  start + length <= cs.size()
+// post: the DNA string in sub is cs[start,...,start+length-1]
+CompressedSequence CompressedSequence::subSequence(size_t start, size_t length) const {
+  CompressedSequence r;
+  r.setSequence(*this, start, length);
+  return r;
+}
+
+
+// use:  cs.append(o, overlap);
+// pre:  overlap <= o.size(), the last overlap bases of cs are o[0,...,overlap-1]
+// post: o[overlap,...,o.size()-1] has been appended to cs
+void CompressedSequence::append(const CompressedSequence& o, size_t overlap) {
+  assert(overlap <= o.size());
+  setSequence(o, overlap, o.size() - overlap, size());
 }
 
 
@@ -388,18 +404,43 @@ size_t CompressedSequence::jump(const char *s, size_t i, int pos, bool reversed)
   assert(i>=0);
   assert(pos >= -1);
   assert(0 <= size() - pos); // this prevents -1 <= _length from giving false
+  size_t nbytes = round_to_bytes(size());
+  size_t avail = reversed ? (size_t) (pos + 1) : size() - (size_t) pos; // bases left in cs
+  const char *r = s + i;
   size_t j = 0;
-  int dir = (reversed) ? -1 : 1;
-  int limit = (reversed) ? -1 : size(); // index limit, lower or upper bound
-  size_t a,b,idx;
-  for (int index = pos; s[i+j] != 0 && index != limit; index+= dir, j++) {
-    assert(index >= 0);
-    assert(size() - index > 0);
-    a = index / 4;
-    b = index % 4;
-    idx = ((data[a]) >> (2*b)) & 0x03;
-    if ((!reversed && s[i+j] != bases[idx]) || (reversed && s[i+j] != bases[3-idx])) {
-      break;
+
+  while (j < avail) {
+    size_t n = std::min<size_t>(32, avail - j);
+
+    // pack the next n bases of the read, m of them are 'A','C','G' or 'T'
+    uint64_t rw = 0;
+    size_t m = 0;
+    for (; m < n; m++) {
+      uint8_t c = codes[(uint8_t) r[j+m]];
+      if (c > 3) {
+        break;
+      }
+      rw |= ((uint64_t) c) << (2*m);
+    }
+
+    // the next n bases of the contig, read backwards and complemented if reversed
+    uint64_t cw;
+    if (!reversed) {
+      cw = load_bases(data, nbytes, pos + j);
+    } else {
+      cw = ~reverse_bases(load_bases(data, nbytes, pos - j - n + 1)) >> (2*(32-n));
+    }
+
+    uint64_t diff = rw ^ cw;
+    if (m < 32) {
+      diff &= (1ULL << (2*m)) - 1;
+    }
+    if (diff != 0) {
+      return j + (__builtin_ctzll(diff) >> 1); // first mismatching base
+    }
+    j += m;
+    if (m < n) {
+      break; // end of read or a base that never matches
     }
   }
   return j;
@@ -14,6 +14,7 @@
  *  - Get kmers from a sequence
  *  - Get length of a sequence
  *  - Easily get length of matching substring from a given string
+ *  - Copy, reverse complement and join sequences a word (32 bases) at a time
  * */
 class CompressedSequence {
  public:
@@ -45,6 +46,9 @@ class CompressedSequence {
 
   void reserveLength(size_t new_length);
 
+  CompressedSequence subSequence(size_t start, size_t length) const;
+  void append(const CompressedSequence& o, size_t overlap = 0);
+
   CompressedSequence rev() const;
   size_t jump(const char *s, size_t i, int pos, bool reversed) const;
 
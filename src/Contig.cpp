@@ -13,24 +13,36 @@ void Contig::initializeCoverage(bool full) {
 
 // use:   c.cover(start,end)
 // pre:   0 <= start , end < c.numKmers();
-// post:  contig is covered from start to end (inclusive) and coveragesum is updated, threadsafe
+// post:  contig is covered from start to end (inclusive) and coveragesum is updated,
+//        threadsafe unless the exact counts are kept
 void Contig::cover(size_t start, size_t end) {
   ccov.cover(start,end);
   if( end < start) {
     swap(start,end);
   }
   __sync_add_and_fetch(&coveragesum,end-start+1);
+  if (!counts.isEmpty()) {
+    counts.add(start, end, 1);
+  }
+}
+
+
+// use:   c.addCoverage(start, end, times)
+// pre:   0 <= start <= end < c.numKmers(), no other thread changes c
+// post:  contig is covered times over from start to end (inclusive) and coveragesum is updated
+void Contig::addCoverage(size_t start, size_t end, size_t times) {
+  ccov.addCoverage(start, end, times);
+  coveragesum += (end-start+1) * times;
+  if (!counts.isEmpty()) {
+    counts.add(start, end, times);
+  }
 }
 
 
 // use:  i = c.memory();
 // post: i is the total memory used by c in bytes
 size_t Contig::memory() const {
-  size_t m = sizeof(ccov) + sizeof(seq);
-  size_t numkmers = numKmers();
-  if (numkmers > ccov.size_limit) {
-    m += ((numkmers + 3) / 4) + 8;
-  }
+  size_t m = sizeof(coveragesum) + ccov.memory() + sizeof(seq) + counts.memory();
   size_t seqlength = length();
   if (!seq.isShort()) {
     m += ((seqlength + 3) / 4);
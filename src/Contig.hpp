@@ -5,22 +5,27 @@
 #include "Kmer.hpp"
 #include "CompressedSequence.hpp"
 #include "CompressedCoverage.hpp"
+#include "CoverageCounts.hpp"
 
 
 /* Short description:
  *  - Use the CompressedSequence class for storing the DNA string
  *  - Use the CompressedCoverage class for storing the kmer coverage
+ *  - counts holds the exact kmer coverage if it has been allocated
  *  */
 class Contig {
  public:
   Contig() : coveragesum(0) {}
   Contig(const char *s, bool full=false) : seq(s) { initializeCoverage(full); }
+  Contig(const CompressedSequence& s, bool full=false) : seq(s) { initializeCoverage(full); }
   void initializeCoverage(bool full);
   void cover(size_t start, size_t end);
+  void addCoverage(size_t start, size_t end, size_t times);
 
   uint64_t coveragesum;
   CompressedCoverage ccov;
   CompressedSequence seq;
+  CoverageCounts counts;
 
   size_t numKmers() const { return seq.size()-Kmer::k+1; }
   size_t length() const { return seq.size(); }
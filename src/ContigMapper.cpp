@@ -10,8 +10,12 @@
 // for debugging
 #include <iostream>
 
+// use:  n = stringMatch(a, b, pos);
+// pre:  a is upper case
+// post: n is the length of the common prefix of a and b[pos,...], ignoring the case of b
 size_t stringMatch(const string& a, const string& b, size_t pos) {
-  return distance(a.begin(),mismatch(a.begin(), a.end(), b.begin() + pos).first);
+  return distance(a.begin(), mismatch(a.begin(), a.end(), b.begin() + pos,
+                                      [](char x, char y) { return x == (y & 0xDF); }).first);
 }
 
 // use: delete cm
@@ -29,7 +33,7 @@ ContigMapper::~ContigMapper() {
 // use:  ContigMapper(sz)
 // pre:  sz >= 0
 // post: new contigmapper object
-ContigMapper::ContigMapper(size_t init) :  bf(NULL) {
+ContigMapper::ContigMapper(size_t init) :  bf(NULL), countCoverage(false), storeShortSeqs(false) {
   limit = Kmer::k;
   stride = Kmer::k;
 }
@@ -37,6 +41,130 @@ ContigMapper::ContigMapper(size_t init) :  bf(NULL) {
 
 
 
+// use:  cm.setStride(stride)
+// pre:  stride > 0, no contigs have been added
+// post: long contigs get a shortcut every stride k-mers, contigs with fewer
+//       than min(k, stride) k-mers are short so a walk of stride steps reaches their ends
+void ContigMapper::setStride(size_t stride_) {
+  assert(stride_ > 0);
+  stride = stride_;
+  limit = std::min<size_t>(Kmer::k, stride);
+}
+
+
+// use:  m = cm.shortcutMemory()
+// post: m is the memory used by the shortcut table in bytes
+size_t ContigMapper::shortcutMemory() const {
+  return shortcuts.memory();
+}
+
+
+// use:  s = ContigMapper::strideForMemory(nkmers, bytes)
+// pre:  nkmers is an estimate of the number of k-mers in the graph
+// post: s is the smallest stride whose shortcut table for nkmers
+//       k-mers is expected to fit in bytes, between 1 and 4k
+size_t ContigMapper::strideForMemory(size_t nkmers, size_t bytes) {
+  // the table doubles when 80% full, so count 2 slots per shortcut
+  size_t per_shortcut = 2 * sizeof(hmap_shortcut_t::value_type);
+  size_t maxstride = 4 * Kmer::k;
+  if (bytes == 0) {
+    return maxstride;
+  }
+  size_t s = (nkmers * per_shortcut + bytes - 1) / bytes;
+  return std::max<size_t>(1, std::min(s, maxstride));
+}
+
+
+// use:  m = ContigMapper::memoryForKmers(nkmers, counts, seqs)
+// pre:  nkmers is an estimate of the number of k-mers in the graph
+// post: m is the expected memory in bytes of the contigs of nkmers k-mers,
+//       without the shortcuts, counts is true if exact coverage is kept and
+//       seqs is true if the sequences of short contigs are kept
+size_t ContigMapper::memoryForKmers(size_t nkmers, bool counts, bool seqs) {
+  // 2 bits of sequence and 2 bits of coverage for every k-mer, and a contig
+  // of about k k-mers with 2 slots in the table of long contigs for growth
+  size_t ncontigs = nkmers / Kmer::k + 1;
+  size_t m = nkmers / 2 + ncontigs * (sizeof(Contig) + 2 * sizeof(hmap_long_contig_t::value_type));
+  if (counts) {
+    m += nkmers; // a byte per k-mer, the counters grow when they fill up
+  }
+
+  // while reads are mapped most contigs are short, at most one for every k-mer,
+  // each with 2 slots in the tables of short contigs
+  size_t nshort = nkmers + 1;
+  m += nshort * 2 * sizeof(hmap_short_contig_t::value_type);
+  if (counts) {
+    m += nshort * 2 * sizeof(hmap_short_counts_t::value_type);
+  }
+  if (seqs) {
+    // and k-1 bases more than its k-mers in the sequence store
+    m += nshort * 2 * sizeof(hmap_short_seqs_t::value_type) + (nkmers + nshort * (Kmer::k + 2)) / 4;
+  }
+  return m;
+}
+
+
+// use:  cm.reserve(nkmers)
+// pre:  the stride has been set, and whether coverage is counted and short sequences
+//       are kept, nkmers is an estimate of the number of k-mers in the graph
+// post: the tables of contigs and shortcuts have room for nkmers k-mers, and the
+//       sequence store for the short contigs, so they do not double, holding the old
+//       and the new table at once, while reads are mapped
+void ContigMapper::reserve(size_t nkmers) {
+  // the tables double when 80% full, there is at most one short contig for every k-mer
+  size_t nshort = nkmers + 1;
+  lContigs.reserve((nkmers / Kmer::k + 1) * 5 / 4);
+  shortcuts.reserve((nkmers / stride + 1) * 5 / 4);
+  sContigs.reserve(nshort * 5 / 4);
+  if (countCoverage) {
+    sCounts.reserve(nshort * 5 / 4);
+  }
+  if (storeShortSeqs) {
+    sSeqs.reserve(nshort * 5 / 4);
+    shortSeqs.reserve((nkmers + nshort * (Kmer::k + 2)) / 4);
+  }
+}
+
+
+// use:  m = cm.shortSequenceMemory()
+// post: m is the memory in bytes used to keep the sequences of short contigs
+size_t ContigMapper::shortSequenceMemory() const {
+  return shortSeqs.memory() + sSeqs.memory();
+}
+
+
+// use:  m = cm.shortContigMemory()
+// post: m is the memory in bytes used by the short contigs and their coverage
+size_t ContigMapper::shortContigMemory() const {
+  size_t m = sContigs.memory() + sCounts.memory();
+  for (auto it = sContigs.begin(); it != sContigs.end(); ++it) {
+    m += it->second.memory() - sizeof(CompressedCoverage);
+  }
+  for (auto it = sCounts.begin(); it != sCounts.end(); ++it) {
+    m += it->second.memory() - sizeof(CoverageCounts);
+  }
+  return m;
+}
+
+
+// use:  m = cm.longContigMemory()
+// post: m is the memory in bytes used by the long contigs, their sequences and coverage
+size_t ContigMapper::longContigMemory() const {
+  size_t m = lContigs.memory();
+  for (auto it = lContigs.begin(); it != lContigs.end(); ++it) {
+    m += it->second->memory();
+  }
+  return m;
+}
+
+
+// use:  m = cm.memory()
+// post: m is the memory in bytes used by cm and everything it owns, the Bloom filter is not counted
+size_t ContigMapper::memory() const {
+  return sizeof(*this) + shortContigMemory() + longContigMemory() + shortcutMemory() + shortSequenceMemory();
+}
+
+
 // user: i = cm.contigCount()
 // pre:
 // post: i is the number of contigs in the mapper
@@ -63,6 +191,9 @@ void ContigMapper::mapRead(const ContigMap& cc) {
     CompressedCoverage& cov = it->second; // reference to the info
     // increase coverage
     cov.cover(cc.dist, cc.dist + cc.len-1);
+    if (countCoverage) {
+      sCounts.find(cc.head)->second.add(cc.dist, cc.dist + cc.len-1, 1);
+    }
   } else {
     // find long contig
     hmap_long_contig_t::iterator it = lContigs.find(cc.head);
@@ -73,19 +204,107 @@ void ContigMapper::mapRead(const ContigMap& cc) {
   }
 }
 
-// use: b = cm.addContig(km,read)
+// use:  cm.mapRead(cc, buf)
+// pre:  cc is a reference to a current contig in cm, no contigs are added until buf is flushed
+// post: the coverage interval of cc has been added to buf, the contig is not changed
+void ContigMapper::mapRead(const ContigMap& cc, CoverageBuffer& buf) {
+  if (cc.isEmpty) {
+    return;
+  } else if (cc.isShort) {
+    hmap_short_contig_t::iterator it = sContigs.find(cc.head);
+    CoverageCounts *counts = countCoverage ? &(sCounts.find(cc.head)->second) : NULL;
+    buf.add(&(it->second), NULL, counts, cc.dist, cc.dist + cc.len-1);
+  } else {
+    Contig *cont = lContigs.find(cc.head)->second;
+    buf.add(&(cont->ccov), cont, NULL, cc.dist, cc.dist + cc.len-1);
+  }
+}
+
+
+// use:  cm.flushCoverage(bufs, part)
+// pre:  no other thread is flushing the same part, bufs were filled by mapRead
+// post: the intervals in part of every buffer have been added to the contigs,
+//       overlapping intervals are merged so every counter word is written once per depth
+void ContigMapper::flushCoverage(vector<CoverageBuffer>& bufs, size_t part) {
+  vector<CoverageBuffer::Interval> v;
+  for (auto& buf : bufs) {
+    v.insert(v.end(), buf.parts[part].begin(), buf.parts[part].end());
+  }
+  sort(v.begin(), v.end(), [](const CoverageBuffer::Interval& a, const CoverageBuffer::Interval& b) {
+    return (a.cov < b.cov) || (a.cov == b.cov && a.start < b.start);
+  });
+
+  vector<pair<size_t, int>> events;
+  for (size_t i = 0; i < v.size(); ) {
+    size_t j = i;
+    events.clear();
+    for (; j < v.size() && v[j].cov == v[i].cov; j++) {
+      events.push_back(make_pair(v[j].start, 1));
+      events.push_back(make_pair(v[j].end + 1, -1));
+    }
+    sort(events.begin(), events.end());
+
+    // sweep over the interval endpoints, covering every stretch of constant depth
+    int depth = 0;
+    size_t from = 0;
+    for (auto& e : events) {
+      if (depth > 0 && e.first > from) {
+        if (v[i].contig != NULL) {
+          v[i].contig->addCoverage(from, e.first - 1, depth);
+        } else {
+          v[i].cov->addCoverage(from, e.first - 1, depth);
+          if (v[i].counts != NULL) {
+            v[i].counts->add(from, e.first - 1, depth);
+          }
+        }
+      }
+      depth += e.second;
+      from = e.first;
+    }
+    i = j;
+  }
+}
+
+
+// use:  buf.add(cov, contig, start, end)
+// pre:  cov is the coverage of contig, or of a short contig if contig is NULL,
+//       counts are the exact counts of the short contig or NULL
+// post: the interval start,...,end (or reverse) has been added to buf
+void CoverageBuffer::add(CompressedCoverage *cov, Contig *contig, CoverageCounts *counts, size_t start, size_t end) {
+  if (end < start) {
+    swap(start, end);
+  }
+  Interval x = {cov, contig, counts, start, end};
+  size_t h = (size_t) ((((uintptr_t) cov) >> 4) * 0x9E3779B97F4A7C15ULL >> 32);
+  parts[h % parts.size()].push_back(x);
+}
+
+
+// use:  buf.clear()
+// post: buf has no intervals
+void CoverageBuffer::clear() {
+  for (auto& p : parts) {
+    p.clear();
+  }
+}
+
+
+// use: b = cm.addContig(km,read,pos,seq,cover)
 // pre:
 // post: either contig string containsin has been added and b == true
 //       or it was present and the coverage information was updated, b == false
+//       the coverage is only updated if cover is true
 //       NOT Threadsafe!
-bool ContigMapper::addContig(Kmer km, const string& read, size_t pos, const string& seq) {
+bool ContigMapper::addContig(Kmer km, const string& read, size_t pos, const string& seq, bool cover) {
   // find the contig string to add
   string s;
   bool selfLoop = false;
   if (!seq.empty()) {
     s = seq;
   } else {
-    findContigSequence(km,s,selfLoop);
+    size_t dist;
+    bool strand;
+    findContigSequence(km,s,selfLoop,dist,strand);
   }
   size_t k = Kmer::k;
   bool found = false;
@@ -94,7 +313,9 @@ bool ContigMapper::addContig(Kmer km, const string& read, size_t pos, const stri
     // ok, check if any other k-mer is mapped
     for (; it != it_end; ++it) {
       ContigMap loopCC = find(it->first);
-      if (!loopCC.isEmpty) {
+      if (!loopCC.isEmpty && !cover) {
+        return true; // the loop is already there, possibly from another k-mer
+      } else if (!loopCC.isEmpty) {
         //cout << it->first.toString() << "matches, pos " << it->second << " to contig with " << loopCC.head.toString() << endl;
         //cout << "strand: " << loopCC.strand << ", dist = " << loopCC.dist << endl;
         // split the read up from pos up to the position of
@@ -139,7 +360,6 @@ bool ContigMapper::addContig(Kmer km, const string& read, size_t pos, const stri
 
   // head is the front
   const char *c = s.c_str();
-  size_t len = s.size();
 
   Kmer head = Kmer(c);
 
@@ -152,28 +372,50 @@ bool ContigMapper::addContig(Kmer km, const string& read, size_t pos, const stri
     if (s.size()-k+1 < limit && !selfLoop) {
       // create a short contig
       sContigs.insert(make_pair(head, CompressedCoverage(s.size()-k+1)));
+      if (countCoverage) {
+        sCounts.insert(make_pair(head, CoverageCounts(s.size()-k+1)));
+      }
+      if (storeShortSeqs) {
+        sSeqs.insert(make_pair(head, shortSeqs.add(s)));
+      }
     } else {
-      lContigs.insert(make_pair(head, new Contig(c)));
-
-      // insert shortcuts every stride k-mers
-      for (size_t i = stride; i < len-k; i += stride) {
-        shortcuts.insert(make_pair(Kmer(c+i),make_pair(head,i)));
+      Contig *cont = new Contig(c);
+      if (countCoverage) {
+        cont->counts = CoverageCounts(cont->numKmers());
+      }
+      lContigs.insert(make_pair(head, cont));
+      addShortcuts(cont->seq, head);
+      if (s.size()-k+1 < k && !selfLoop) {
+        strideHeads.push_back(head);
       }
-      // also insert shortcut for last k-mer
-      shortcuts.insert(make_pair(Kmer(c+len-k),make_pair(head,len-k)));
-
     }
   } else {
     //cout << "no wait, found it already" << endl;
   }
 
-  // map the read
-  cc = findContig(km,read, pos);
-  cc.selfLoop = selfLoop;
-  mapRead(cc);
+  if (cover) {
+    // map the read
+    cc = findContig(km,read, pos);
+    cc.selfLoop = selfLoop;
+    mapRead(cc);
+  }
   return found;
 }
 
+
+// use:  cm.coverAll()
+// pre:  no reads have been mapped
+// post: every contig is fully covered, coverage sums are 2 per k-mer
+void ContigMapper::coverAll() {
+  for (auto& kv : sContigs) {
+    kv.second.setFull();
+  }
+  for (auto& kv : lContigs) {
+    kv.second->ccov.setFull();
+    kv.second->coveragesum = 2*kv.second->numKmers();
+  }
+}
+
 // use:  b = cm.checkTip(tip)
 // pre:  tip is the head of a tip
 // post: true if there is a full alternative branch to the tip
@@ -230,13 +472,19 @@ bool ContigMapper::checkTip(Kmer tip) {
 }
 
 
-// use:  cm.findContigSequence(km, s, selfLoop)
-// pre:  km is in the bloom filter
+static void contigFromWalks(Kmer km, const string& fw_s, const string& bw_s, string& s, size_t& dist, bool& strand);
+
+// contigs walked per call of findContigSequences when all short contigs are walked again
+static const size_t walk_seqs = 1 << 16;
+
+// use:  cm.findContigSequence(km, s, selfLoop, dist, strand, cache)
+// pre:  km is in the bloom filter, cache is NULL or used by this thread only
 // post: s is the contig containing the kmer km
 //       and the first k-mer in s is smaller (wrt. < operator)
 //       than the last kmer
 //       selfLoop is true of the contig is a loop or hairpin
-void ContigMapper::findContigSequence(Kmer km, string& s, bool& selfLoop) {
+//       km is at position dist in s if strand is true, else its twin is
+void ContigMapper::findContigSequence(Kmer km, string& s, bool& selfLoop, size_t& dist, bool& strand, BloomFilterCache *cache) {
   //cout << " s = " << s << endl;
   string fw_s;
   Kmer end = km;
@@ -247,7 +495,7 @@ void ContigMapper::findContigSequence(Kmer km, string& s, bool& selfLoop) {
   size_t j = 0;
   size_t dummy;
   //cout << end.toString();
-  while (fwBfStep(end,end,c,dummy)) {
+  while (fwBfStep(end,end,c,dummy,cache)) {
     if (end == km) {
       //cout << "Got a self-loop in contig: " << fw_s << endl;
       //cout << km.toString() << " => " << end.toString() << endl;
@@ -267,7 +515,7 @@ void ContigMapper::findContigSequence(Kmer km, string& s, bool& selfLoop) {
   Kmer front = km;
   Kmer first = front;
   if (!selfLoop) {
-    while (bwBfStep(front,front,c,dummy)) {
+    while (bwBfStep(front,front,c,dummy,cache)) {
       if (front == km) {
         //cout << "Got a self-loop in contig: " << fw_s << endl;
         //cout << km.toString() << " => " << end.toString() << endl;
@@ -282,12 +530,22 @@ void ContigMapper::findContigSequence(Kmer km, string& s, bool& selfLoop) {
       bw_s.push_back(c);
       first = front;
     }
-    reverse(bw_s.begin(), bw_s.end());
   }
 
+  contigFromWalks(km, fw_s, bw_s, s, dist, strand);
+}
+
+
+// use:  contigFromWalks(km, fw_s, bw_s, s, dist, strand)
+// pre:  fw_s are the bases walked forward from km, bw_s the bases walked backward
+//       in the order they were found
+// post: s is the contig, its first k-mer is smaller than the twin of its last k-mer,
+//       km is at position dist in s if strand is true, else its twin is
+static void contigFromWalks(Kmer km, const string& fw_s, const string& bw_s, string& s, size_t& dist, bool& strand) {
   size_t k = Kmer::k;
+  s.clear();
   s.reserve(k + fw_s.size()+bw_s.size());
-  s.append(bw_s);
+  s.append(bw_s.rbegin(), bw_s.rend());
   //cout << "bw_s = " << bw_s << endl;
 
   char tmp[Kmer::MAX_K];
@@ -302,18 +560,163 @@ void ContigMapper::findContigSequence(Kmer km, string& s, bool& selfLoop) {
   Kmer head(t);
   //cout << "After append, s = " << s << endl;
   Kmer tail = Kmer(t+s.size()-k).twin();
+  dist = bw_s.size();
+  strand = true;
   if (tail < head) { // reverse complement the string
     s = CompressedSequence(s).rev().toString();
+    dist = s.size() - k - dist;
+    strand = false;
   }
   //cout << "After reverse, s = " << s << endl;
 }
 
 
-// use:  cc = cm.findContig(km,s,pos)
-// pre:  s[pos,pos+k-1] is the kmer km
+/* Short description:
+ *  - The state of one walk in findContigSequences, it takes the same steps as
+ *    findContigSequence but stops after each stage of Bloom filter lookups
+ *  - Stage 0 prefetches the neighbours of cur, stage 1 checks them and prefetches
+ *    the neighbours of the only one found, stage 2 checks those and moves cur
+ * */
+struct UnitigWalk {
+  Kmer km, twin;
+  Kmer cur, next; // cur is the end walking forward, the front walking backward
+  char c;         // the base used to reach next
+  int stage;
+  bool forward, selfLoop, done;
+  uint64_t hashes[4];
+  size_t index;   // of km in the batch
+  string fw_s, bw_s;
+};
+
+
+// use:  startWalk(w, km, index)
+// post: w walks the contig of km forward, nothing has been looked up
+static void startWalk(UnitigWalk& w, Kmer km, size_t index) {
+  w.km = km;
+  w.twin = km.twin();
+  w.cur = km;
+  w.stage = 0;
+  w.forward = true;
+  w.selfLoop = false;
+  w.done = false;
+  w.index = index;
+  w.fw_s.clear();
+  w.bw_s.clear();
+}
+
+
+// use:  stepWalk(bf, w)
+// pre:  w is not done
+// post: w has advanced by one stage, w.done is true if both directions have ended
+static void stepWalk(const BlockedBloomFilter& bf, UnitigWalk& w) {
+  size_t i, j = 0, count = 0;
+
+  if (w.stage == 0) {
+    for (i = 0; i < 4; ++i) {
+      Kmer n = w.forward ? w.cur.forwardBase(alpha[i]) : w.cur.backwardBase(alpha[i]);
+      w.hashes[i] = bf.hash(n.rep());
+      bf.prefetch(w.hashes[i]);
+    }
+    w.stage = 1;
+    return;
+  }
+
+  for (i = 0; i < 4; ++i) {
+    if (bf.containsHash(w.hashes[i])) {
+      j = i;
+      if (++count > 1) {
+        break;
+      }
+    }
+  }
+
+  bool moved = false;
+  if (w.stage == 1) {
+    if (count == 1) {
+      // exactly one neighbour, check that cur is its only neighbour the other way
+      w.c = alpha[j];
+      w.next = w.forward ? w.cur.forwardBase(w.c) : w.cur.backwardBase(w.c);
+      for (i = 0; i < 4; ++i) {
+        Kmer n = w.forward ? w.next.backwardBase(alpha[i]) : w.next.forwardBase(alpha[i]);
+        w.hashes[i] = bf.hash(n.rep());
+        bf.prefetch(w.hashes[i]);
+      }
+      w.stage = 2;
+      return;
+    }
+  } else {
+    assert(count >= 1);
+    if (count == 1 && w.next != w.cur) {
+      // the same checks as the loops in findContigSequence
+      if (w.next == w.km) {
+        w.selfLoop = true;
+      } else if (w.next != w.twin && w.next != w.cur.twin()) {
+        (w.forward ? w.fw_s : w.bw_s).push_back(w.c);
+        w.cur = w.next;
+        moved = true;
+      }
+    }
+  }
+
+  w.stage = 0;
+  if (!moved) {
+    // this direction has ended
+    if (w.forward && !w.selfLoop) {
+      w.forward = false;
+      w.cur = w.km;
+    } else {
+      w.done = true;
+    }
+  }
+}
+
+
+// use:  cm.findContigSequences(kms, seqs, selfLoops)
+// pre:  every k-mer in kms is in the bloom filter
+// post: seqs[i] and selfLoops[i] are what findContigSequence(kms[i], ...) gives,
+//       many walks are advanced in turn so the Bloom filter lookups of one walk
+//       are loaded from memory while the others are checking theirs
+void ContigMapper::findContigSequences(const vector<Kmer>& kms, vector<string>& seqs, vector<bool>& selfLoops) const {
+  assert(bf != NULL);
+  seqs.assign(kms.size(), string());
+  selfLoops.assign(kms.size(), false);
+
+  vector<UnitigWalk> walks(std::min(kms.size(), walk_batch));
+  size_t next = 0, active = 0;
+  for (auto& w : walks) {
+    startWalk(w, kms[next], next);
+    ++next;
+    ++active;
+  }
+
+  while (active > 0) {
+    for (auto& w : walks) {
+      if (w.done) {
+        continue;
+      }
+      stepWalk(*bf, w);
+      if (w.done) {
+        size_t dist;
+        bool strand;
+        contigFromWalks(w.km, w.fw_s, w.bw_s, seqs[w.index], dist, strand);
+        selfLoops[w.index] = w.selfLoop;
+        if (next < kms.size()) {
+          startWalk(w, kms[next], next);
+          ++next;
+        } else {
+          --active;
+        }
+      }
+    }
+  }
+}
+
+
+// use:  cc = cm.findContig(km,s,pos,cache)
+// pre:  s[pos,pos+k-1] is the kmer km, cache is NULL or used by this thread only
 // post: cc contains either the reference to the contig position
 //       or empty if none found
-ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos) const {
+ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos, BloomFilterCache *cache) const {
   assert(bf != NULL);
   size_t k = Kmer::k;
 
@@ -348,7 +751,7 @@ ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos) const {
   bool hairpin = false;
   // check <k steps ahead in fw direction
   size_t fw_deg;
-  while (fw_dist < stride && fwBfStep(end, end, c, fw_deg)) {
+  while (fw_dist < stride && fwBfStep(end, end, c, fw_deg, cache)) {
     if (end == km) {
       selfLoop = true;
       break;
@@ -374,7 +777,7 @@ ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos) const {
   bool reverseHairpin = false;
   Kmer front = km;
   Kmer first = front;
-  while (bw_dist < stride && bwBfStep(front,front,c,bw_deg)) {
+  while (bw_dist < stride && bwBfStep(front,front,c,bw_deg,cache)) {
     if (front == km) {
       selfLoop = true;
       break; // ok, we've reached around
@@ -419,6 +822,9 @@ ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos) const {
     ContigMap rcc(cc.head, km_dist, len, cc.size, cc.strand, cc.isShort);
     rcc.selfLoop = selfLoop;
     rcc.isIsolated = (fw_deg == 0 && bw_deg == 0 && len < k );
+    if (!selfLoop && !hairpin) {
+      extendMatch(rcc, s, pos);
+    }
 
     return rcc;
   } else {
@@ -434,15 +840,19 @@ ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos) const {
       ContigMap rcc(cc.head, km_dist, len, cc.size, cc.strand, cc.isShort);
       rcc.selfLoop = selfLoop;
       rcc.isIsolated = (fw_deg == 0 && bw_deg == 0 && len < k);
+      if (!selfLoop && !hairpin) {
+        extendMatch(rcc, s, pos);
+      }
       return rcc;
     }
   }
 
-  if (bw_dist == k || fw_dist == k || selfLoop) {
+  if (bw_dist == stride || fw_dist == stride || selfLoop) {
+    // a shortcut is at most stride k-mers ahead, check every k-mer on the way
     Kmer short_end = km;
     size_t fd = 0;
     size_t dummy;
-    while (fd < k && fwBfStep(short_end,short_end,c, dummy)) {
+    while (fd < stride && fwBfStep(short_end,short_end,c, dummy, cache)) {
       ++fd;
       cc = this->find(short_end);
       if (! cc.isEmpty) {
@@ -472,14 +882,33 @@ ContigMap ContigMapper::findContig(Kmer km, const string& s, size_t pos) const {
   return rcc;
 }
 
-// use:  b = cm.bwBfStep(km,front,c,deg)
-// pre:  km is in the bloom filter
+// use:  cm.extendMatch(cc, s, pos)
+// pre:  cc maps s[pos,pos+k-1] and the cc.len-1 k-mers after it to a contig
+// post: if the contig is long, cc.len is the number of consecutive k-mers of s
+//       from pos that are in the contig, a walk bounded by the stride can stop short
+void ContigMapper::extendMatch(ContigMap& cc, const string& s, size_t pos) const {
+  if (cc.isShort) {
+    return;
+  }
+  size_t k = Kmer::k;
+  const CompressedSequence& seq = lContigs.find(cc.head)->second->seq;
+  if (cc.strand) {
+    cc.len = seq.jump(s.c_str(), pos, cc.dist, false) - k + 1;
+  } else {
+    size_t km_dist = cc.dist + cc.len - 1; // where the twin of s[pos,pos+k-1] starts
+    cc.len = seq.jump(s.c_str(), pos, km_dist + k - 1, true) - k + 1;
+    cc.dist = km_dist - (cc.len - 1);
+  }
+}
+
+// use:  b = cm.bwBfStep(km,front,c,deg,cache)
+// pre:  km is in the bloom filter, the filter is queried through cache unless it is NULL
 // post: b is true if km is inside a contig, in that
 //       case end is the bw link and c is the nucleotide used for the link.
 //       if b is false, front and c are not updated
 //       if km is an isolated self link (e.g. 'AAA') i.e. end == km then returns false
 //       deg is the backwards degree of the front
-bool ContigMapper::bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg) const {
+bool ContigMapper::bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg, BloomFilterCache *cache) const {
   size_t i,j;
   size_t bw_count = 0;
   deg = 0;
@@ -489,7 +918,7 @@ bool ContigMapper::bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg) const {
   j = -1;
   for (i = 0; i < 4; ++i) {
     Kmer bw_rep = front.backwardBase(alpha[i]).rep();
-    if (bf->contains(bw_rep)) {
+    if (inBloomFilter(bw_rep, cache)) {
       j = i;
       ++bw_count;
       if (bw_count > 1) {
@@ -509,7 +938,7 @@ bool ContigMapper::bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg) const {
   size_t fw_count = 0;
   for (i = 0; i < 4; ++i) {
     Kmer fw_rep = bw.forwardBase(alpha[i]).rep();
-    if (bf->contains(fw_rep)) {
+    if (inBloomFilter(fw_rep, cache)) {
       ++fw_count;
       if (fw_count > 1) {
         break;
@@ -532,14 +961,14 @@ bool ContigMapper::bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg) const {
   }
 }
 
-// use:  b = cm.fwBfStep(km,end,c,deg)
-// pre:  km is in the bloom filter
+// use:  b = cm.fwBfStep(km,end,c,deg,cache)
+// pre:  km is in the bloom filter, the filter is queried through cache unless it is NULL
 // post: b is true if km is inside a contig, in that
 //       case end is the fw link and c is the nucleotide used for the link.
 //       if b is false, end and c are not updated
 //       if km is an isolated self link (e.g. 'AAA') i.e. end == km then returns false
 //       deg is the degree of the end
-bool ContigMapper::fwBfStep(Kmer km, Kmer& end, char& c, size_t& deg) const {
+bool ContigMapper::fwBfStep(Kmer km, Kmer& end, char& c, size_t& deg, BloomFilterCache *cache) const {
   size_t i,j;
   size_t fw_count = 0;
   //size_t k = Kmer::k;
@@ -548,7 +977,7 @@ bool ContigMapper::fwBfStep(Kmer km, Kmer& end, char& c, size_t& deg) const {
   j = -1;
   for (i = 0; i < 4; ++i) {
     Kmer fw_rep = end.forwardBase(alpha[i]).rep();
-    if (bf->contains(fw_rep)) {
+    if (inBloomFilter(fw_rep, cache)) {
       j = i;
       ++fw_count;
       if (fw_count > 1) {
@@ -570,7 +999,7 @@ bool ContigMapper::fwBfStep(Kmer km, Kmer& end, char& c, size_t& deg) const {
   size_t bw_count = 0;
   for (i = 0; i < 4; ++i) {
     Kmer bw_rep = fw.backwardBase(alpha[i]).rep();
-    if (bf->contains(bw_rep)) {
+    if (inBloomFilter(bw_rep, cache)) {
       ++bw_count;
       if (bw_count > 1) {
         break;
@@ -627,6 +1056,25 @@ ContigMap ContigMapper::find(Kmer km) const {
 
 
 
+// use:  mapper.shortContigSequences(heads, seqs, selfLoops)
+// pre:  every k-mer in heads is the head of a short contig
+// post: seqs[i] is the sequence of the short contig with head heads[i], read from
+//       shortSeqs if they are stored and walked in the bloom filter otherwise
+void ContigMapper::shortContigSequences(const vector<Kmer>& heads, vector<string>& seqs, vector<bool>& selfLoops) const {
+  if (!storeShortSeqs) {
+    findContigSequences(heads, seqs, selfLoops);
+    return;
+  }
+  size_t k = Kmer::k;
+  seqs.resize(heads.size());
+  selfLoops.assign(heads.size(), false); // self-loops are never short
+  for (size_t i = 0; i < heads.size(); i++) {
+    size_t len = sContigs.find(heads[i])->second.size() + k - 1;
+    seqs[i] = shortSeqs.get(sSeqs.find(heads[i])->second, len);
+  }
+}
+
+
 // use:  mapper.moveShortContigs()
 // pre:  nothing
 // post: all short contigs have been moved from sContigs to lContigs
@@ -634,17 +1082,38 @@ ContigMap ContigMapper::find(Kmer km) const {
 void ContigMapper::moveShortContigs() {
   size_t k = Kmer::k;
   lContigs.reserve(lContigs.size() + sContigs.size());
-  for (hmap_short_contig_t::iterator it = sContigs.begin(); it != sContigs.end(); ) {
-    string s;
-    bool b;
-    findContigSequence(it->first,s, b);
-    assert(it->first == Kmer(s.c_str()));
-    Contig *c = new Contig(s.c_str()+k, true);
-    c->coveragesum = 2*(s.size() - k+1); // not 100% correct
-    lContigs.insert(make_pair(it->first,c));
-    sContigs.erase(it++); // note post-increment
+
+  vector<Kmer> heads;
+  heads.reserve(sContigs.size());
+  for (hmap_short_contig_t::iterator it = sContigs.begin(); it != sContigs.end(); ++it) {
+    heads.push_back(it->first);
+  }
+
+  // walk the contigs a batch at a time, the walks in a batch are interleaved
+  vector<Kmer> batch;
+  vector<string> seqs;
+  vector<bool> selfLoops;
+  for (size_t i = 0; i < heads.size(); i += walk_seqs) {
+    batch.assign(heads.begin() + i, heads.begin() + std::min(i + walk_seqs, heads.size()));
+    shortContigSequences(batch, seqs, selfLoops);
+    for (size_t j = 0; j < batch.size(); j++) {
+      const string& s = seqs[j];
+      assert(batch[j] == Kmer(s.c_str()));
+      Contig *c = new Contig(s.c_str()+k, true);
+      if (countCoverage) {
+        hmap_short_counts_t::iterator cit = sCounts.find(batch[j]);
+        c->coveragesum = cit->second.sum(0, cit->second.size()-1);
+      } else {
+        c->coveragesum = 2*(s.size() - k+1); // not 100% correct
+      }
+      lContigs.insert(make_pair(batch[j],c));
+      sContigs.erase(batch[j]);
+    }
   }
   assert(sContigs.size() == 0);
+  sCounts.clear();
+  sSeqs.clear();
+  shortSeqs.clear();
 }
 
 // use:  mapper.fixShortContigs()
@@ -656,17 +1125,13 @@ void ContigMapper::fixShortContigs() {
   for (hmap_long_contig_t::iterator it = lContigs.begin(); it != lContigs.end(); ++it) {
     Contig *c = it->second;
     if (c->length() < k) { // check the strict inequality here
-      CompressedSequence& seq = c->seq;
-      string s = seq.toString(); // copy
-      seq.reserveLength(seq.size()+k);
-      seq.setSequence(it->first, k);
-      seq.setSequence(s,s.size(),k);
+      CompressedSequence fixed(it->first); // head k-mer followed by the stored rest
+      fixed.append(c->seq);
+      c->seq = fixed;
+      const CompressedSequence& seq = c->seq;
 
       if (seq.size() > k) {
-        for (size_t i = stride; i < seq.size() - k; i+= stride) {
-          shortcuts.insert(make_pair(seq.getKmer(i), make_pair(it->first, i)));
-        }
-        shortcuts.insert(make_pair(seq.getKmer(seq.size()-k), make_pair(it->first, seq.size()-k)));
+        addShortcuts(seq, it->first);
       }
     }
   }
@@ -756,9 +1221,8 @@ size_t ContigMapper::removeIsolatedContigs() {
     if (!cc.isEmpty) {
       assert(km == cc.head);
       Contig *contig = lContigs.find(cc.head)->second;
-      string seq = contig->seq.toString();
 
-      removeShortcuts(seq); // just playing it safe
+      removeShortcuts(contig->seq); // just playing it safe
       lContigs.erase(cc.head);
       delete contig;
       rem++;
@@ -776,7 +1240,11 @@ size_t ContigMapper::clipTips() {
 
   assert(sContigs.size() == 0);
 
-  vector<Kmer> clips;
+  // the heads of the tips with one neighbour and the other branches
+  // of the neighbour, alts[altStart[i]..altStart[i+1]) for tip i
+  vector<Kmer> tips;
+  vector<Kmer> alts;
+  vector<size_t> altStart(1, 0);
   //typedef hmap_long_contig_t::const_iterator lit_t;
   //for (lit_t it = lContigs.begin(); it != lContigs.end(); ++it) {
   for (auto& kv : lContigs) {
@@ -804,33 +1272,70 @@ size_t ContigMapper::clipTips() {
       }
     }
 
-    bool clip = false;
     if (fw_count == 0 && bw_count == 1) {
       for (size_t i = 0; i < 4; i++) {
         Kmer alt = bw_cand.forwardBase(alpha[i]);
         if (alt != head) {
-          ContigMap cc = find(alt);
-          if (cc.size > kmerlen) {
-            clip = true;
-          }
+          alts.push_back(alt);
         }
       }
-    }
-    if (fw_count == 1 && bw_count == 0) {
+    } else if (fw_count == 1 && bw_count == 0) {
       // check alternative
       for (size_t i = 0; i < 4; i++) {
         Kmer alt = fw_cand.backwardBase(alpha[i]);
         if (alt != tail) {
-          ContigMap cc = find(alt);
-          if (cc.size >= kmerlen) {
-            clip = true;
-          }
+          alts.push_back(alt);
         }
       }
+    } else {
+      continue;
     }
+    tips.push_back(kv.first);
+    altStart.push_back(alts.size());
+  }
 
-    if (clip) {
-      clips.push_back(kv.first);
+  // a tip is clipped if another branch is in a contig with more k-mers than the tip,
+  // find gets the branches at the ends and the shortcuts of the contigs, the rest are
+  // looked for by going over all the contigs, so the tips clipped do not depend on
+  // the stride
+  KmerHashTable<size_t> altKmers; // k-mers in the contig of each branch, 0 if in none
+  for (auto& alt : alts) {
+    altKmers.insert(make_pair(alt.rep(), 0));
+  }
+  bool missing = false;
+  for (auto& kv : altKmers) {
+    ContigMap cc = find(kv.first);
+    if (!cc.isEmpty) {
+      kv.second = lContigs.find(cc.head)->second->numKmers();
+    } else {
+      missing = true;
+    }
+  }
+  if (missing) {
+    for (auto& kv : lContigs) {
+      const CompressedSequence& seq = kv.second->seq;
+      size_t n = kv.second->numKmers();
+      Kmer km = seq.getKmer(0);
+      for (size_t i = 0; i < n; i++) {
+        if (i > 0) {
+          km = km.forwardBase(seq[i+k-1]);
+        }
+        KmerHashTable<size_t>::iterator it = altKmers.find(km.rep());
+        if (it != altKmers.end()) {
+          it->second = n;
+        }
+      }
+    }
+  }
+
+  vector<Kmer> clips;
+  for (size_t i = 0; i < tips.size(); i++) {
+    size_t kmerlen = lContigs.find(tips[i])->second->numKmers();
+    for (size_t j = altStart[i]; j < altStart[i+1]; j++) {
+      if (altKmers.find(alts[j].rep())->second > kmerlen) {
+        clips.push_back(tips[i]);
+        break;
+      }
     }
   }
 
@@ -840,9 +1345,8 @@ size_t ContigMapper::clipTips() {
     ContigMap cc = find(km);
     if (!cc.isEmpty) {
       Contig *contig = lContigs.find(cc.head)->second;
-      string seq = contig->seq.toString();
 
-      removeShortcuts(seq); // just playing it safe
+      removeShortcuts(contig->seq); // just playing it safe
       lContigs.erase(cc.head);
       delete contig;
       clipped++;
@@ -904,8 +1408,6 @@ size_t ContigMapper::joinAllContigs() {
       // both kmers are still end-kmers
       Contig *headContig = lContigs.find(cHead.head)->second;
       Contig *tailContig = lContigs.find(cTail.head)->second;
-      string headSeq = headContig->seq.toString();
-      string tailSeq = tailContig->seq.toString();
 
       bool headDir = true;
       bool tailDir = true;
@@ -929,41 +1431,27 @@ size_t ContigMapper::joinAllContigs() {
 
 
       // remove shortcuts
-      removeShortcuts(headSeq);
-      removeShortcuts(tailSeq);
+      removeShortcuts(headContig->seq);
+      removeShortcuts(tailContig->seq);
 
 
       //cout << "headdir, tailDir: " << headDir << ", " << tailDir << endl;
-      if (!headDir) {
-        headSeq = CompressedSequence(headSeq).rev().toString();
-      }
-      if (!tailDir) {
-        tailSeq = CompressedSequence(tailSeq).rev().toString();
-      }
-
-      //cout << "joining" << endl << headSeq << endl;
-
-
-      string joinSeq;
-      joinSeq.append(headSeq);
-      joinSeq.append(tailSeq, k-1, string::npos);
+      CompressedSequence joinSeq = headDir ? headContig->seq : headContig->seq.rev();
+      CompressedSequence tailSeq = tailDir ? tailContig->seq : tailContig->seq.rev();
 
+      assert(joinSeq.getKmer(joinSeq.size()-k).forwardBase(tailSeq[k-1]) == tailSeq.getKmer(0));
 
-      //cout << string(headSeq.size()-k+1, ' ') << tailSeq << endl;
-      //cout << joinSeq << endl;
+      joinSeq.append(tailSeq, k-1);
 
-
-      assert(headSeq.substr(headSeq.size()-k+1) == tailSeq.substr(0,k-1));
-
-      Contig *c = new Contig(joinSeq.c_str(), true);
+      Contig *c = new Contig(joinSeq, true);
       c->coveragesum = headContig->coveragesum + tailContig->coveragesum;
       lContigs.erase(cHead.head);
       lContigs.erase(cTail.head);
       delete headContig;
       delete tailContig;
-      Kmer cHead(joinSeq.c_str());
+      Kmer cHead = joinSeq.getKmer(0);
       lContigs.insert(make_pair(cHead,c));
-      shortcuts.insert(make_pair(Kmer(joinSeq.c_str()+joinSeq.size()-k), make_pair(cHead, joinSeq.size()-k)));
+      addShortcuts(joinSeq, cHead);
       joined++;
     }
 
@@ -1085,6 +1573,24 @@ pair<size_t, size_t> ContigMapper::splitAllContigs() {
 
   size_t k = Kmer::k;
 
+  // contigs that are only long because of a stride below k become short
+  // with their coverage, so the graph is the same for every stride
+  for (vector<Kmer>::iterator it = strideHeads.begin(); it != strideHeads.end(); ++it) {
+    hmap_long_contig_t::iterator lit = lContigs.find(*it);
+    Contig *cont = lit->second;
+    sContigs.insert(make_pair(*it, cont->ccov));
+    if (countCoverage) {
+      sCounts.insert(make_pair(*it, cont->counts));
+    }
+    if (storeShortSeqs) {
+      sSeqs.insert(make_pair(*it, shortSeqs.add(cont->seq.toString())));
+    }
+    removeShortcuts(cont->seq);
+    lContigs.erase(lit);
+    delete cont;
+  }
+  strideHeads.clear();
+
   size_t split = 0, deleted =0 ;
 
   /*  size_t l_contigcount = lContigs.size();
@@ -1093,13 +1599,26 @@ pair<size_t, size_t> ContigMapper::splitAllContigs() {
 
   // for each short-contig
   typedef vector<pair<int,int>> split_vector_t;
-  vector<string> split_contigs;
-  for (hmap_short_contig_t::iterator it = sContigs.begin(); it != sContigs.end(); ) {
+  vector<pair<CompressedSequence, uint64_t>> split_contigs;
+
+  vector<Kmer> heads;
+  for (hmap_short_contig_t::iterator it = sContigs.begin(); it != sContigs.end(); ++it) {
     // check if we should split it up
     if (! it->second.isFull()) {
-      string s;
-      bool selfLoop = false;
-      findContigSequence(it->first,s, selfLoop);
+      heads.push_back(it->first);
+    }
+  }
+
+  // walk the contigs a batch at a time, the walks in a batch are interleaved
+  vector<Kmer> batch;
+  vector<string> seqs;
+  vector<bool> selfLoops;
+  for (size_t i = 0; i < heads.size(); i += walk_seqs) {
+    batch.assign(heads.begin() + i, heads.begin() + std::min(i + walk_seqs, heads.size()));
+    shortContigSequences(batch, seqs, selfLoops);
+
+    for (size_t j = 0; j < batch.size(); j++) {
+      hmap_short_contig_t::iterator it = sContigs.find(batch[j]);
       split_vector_t sp = it->second.splittingVector();
 
       if (sp.empty()) {
@@ -1108,52 +1627,44 @@ pair<size_t, size_t> ContigMapper::splitAllContigs() {
         split++;
       }
 
-      if (selfLoop) {
+      if (selfLoops[j]) {
         cout << "Splitting a self-loop, not implemented" << endl;
       }
 
       // remember small contigs
       // TODO: insert only middle part, if we are discarding small ones
+      CompressedSequence seq(seqs[j]);
+      const CoverageCounts *counts = countCoverage ? &(sCounts.find(it->first)->second) : NULL;
       for (split_vector_t::iterator sit = sp.begin(); sit != sp.end(); ++sit) {
         size_t pos = sit->first;
         size_t len = sit->second - pos;
-        split_contigs.push_back(s.substr(pos,len+k-1));
+        uint64_t sum = counts ? counts->sum(pos, pos+len-1) : 2*len; // fake sum without counts
+        split_contigs.push_back(make_pair(seq.subSequence(pos,len+k-1), sum));
       }
 
 
       // erase the split contig
-      sContigs.erase(it++); // note: post-increment
-    } else {
-      ++it;
+      if (countCoverage) {
+        sCounts.erase(it->first);
+      }
+      if (storeShortSeqs) {
+        sSeqs.erase(it->first);
+      }
+      sContigs.erase(it);
     }
   }
 
   // insert short contigs
-  for (vector<string>::iterator it = split_contigs.begin(); it != split_contigs.end(); ++it) {
-    if (it->size() >= k) {
-      //bool rev = false;
-      const char *s = it->c_str();
-      Kmer head = Kmer(s); //Kmer(s).rep();
-      //Kmer tail = KmKmer((s + it->size()-k)).rep();
-      /*if (tail < head) {
-      swap(head,tail);
-      rev = true;
-      } */
+  for (vector<pair<CompressedSequence, uint64_t>>::iterator it = split_contigs.begin(); it != split_contigs.end(); ++it) {
+    const CompressedSequence& seq = it->first;
+    if (seq.size() >= k) {
+      Kmer head = seq.getKmer(0);
       // insert contigs into the long contigs, so that the sequence is stored!
-      Contig *cont = NULL;
-      //if (!rev) {
-      cont = new Contig(s,true);
-      /* } else {
-      string srs = CompressedSequence(s).rev().toString();
-      const char *rs = srs.c_str();
-      cont = new Contig(rs+k,true);
-      }*/
-      cont->coveragesum = 2 * (it->size()-k+1); // fake sum, TODO: keep track of this!
+      Contig *cont = new Contig(seq,true);
+      cont->coveragesum = it->second;
       lContigs.insert(make_pair(head,cont));
-      if (it->size() > k) {
-        size_t lastpos = it->size()-k;
-        shortcuts.insert(make_pair(Kmer(s+lastpos),make_pair(head,lastpos)));
-        //shortcuts.insert(make_pair(head, make_pair(s+lastpos, lastpos)));
+      if (seq.size() > k) {
+        addShortcuts(seq, head);
       }
     }
   }
@@ -1162,10 +1673,10 @@ pair<size_t, size_t> ContigMapper::splitAllContigs() {
 
 
   // long contigs
-  vector<pair<string, uint64_t>> long_split_contigs;
+  vector<pair<CompressedSequence, uint64_t>> long_split_contigs;
   for (hmap_long_contig_t::iterator it = lContigs.begin(); it != lContigs.end(); ) {
     if (! it->second->ccov.isFull()) {
-      const string& s = it->second->seq.toString();
+      const CompressedSequence& seq = it->second->seq;
       CompressedCoverage& ccov = it->second->ccov;
       pair<size_t, size_t> lowpair = ccov.lowCoverageInfo();
       size_t lowcount = lowpair.first;
@@ -1181,14 +1692,21 @@ pair<size_t, size_t> ContigMapper::splitAllContigs() {
       }
 
       // TODO: discard short middle pieces
+      const CoverageCounts& counts = it->second->counts;
       for (split_vector_t::iterator sit = sp.begin(); sit != sp.end(); ++sit) {
         size_t pos = sit->first;
         size_t len = sit->second - pos;
-        long_split_contigs.push_back(make_pair(s.substr(pos,len+k-1),(totalcoverage * len)/(ccov.size() - lowcount)));
+        uint64_t sum;
+        if (!counts.isEmpty()) {
+          sum = counts.sum(pos, pos+len-1);
+        } else {
+          sum = (totalcoverage * len)/(ccov.size() - lowcount); // estimate without counts
+        }
+        long_split_contigs.push_back(make_pair(seq.subSequence(pos,len+k-1), sum));
       }
 
       // remove shortcuts
-      removeShortcuts(s);
+      removeShortcuts(seq);
 
       // erase the split contig
       delete it->second;
@@ -1199,57 +1717,72 @@ pair<size_t, size_t> ContigMapper::splitAllContigs() {
     }
   }
   // insert the pieces back
-  for (vector<pair<string, uint64_t>>::iterator it = long_split_contigs.begin(); it != long_split_contigs.end(); ++it) {
+  for (vector<pair<CompressedSequence, uint64_t>>::iterator it = long_split_contigs.begin(); it != long_split_contigs.end(); ++it) {
     if (it->first.size() >= k) {
-      const char *s = it->first.c_str();
-
       size_t len = it->first.size();
-      Kmer head = Kmer(s);
-      Kmer tail = Kmer((s+len-k)).twin();
-
-      string tmp;
+      Kmer head = it->first.getKmer(0);
+      Kmer tail = it->first.getKmer(len-k).twin();
 
       if (tail < head) {
         swap(head,tail);
-        CompressedSequence c(s);
-        tmp = c.rev().toString(); // TODO: create better utility methods!
-        s = tmp.c_str();
+        it->first = it->first.rev();
       }
+      const CompressedSequence& seq = it->first;
 
       // insert new contig
-      Contig *cont = new Contig(s,true);
+      Contig *cont = new Contig(seq,true);
       cont->coveragesum = it->second;
-      //cout << "inserting " << s << endl;
+      //cout << "inserting " << seq.toString() << endl;
       lContigs.insert(make_pair(head, cont));
 
       // create new shortcuts
-      for (size_t i = k; i < len-k; i+= k) {
-        //cout << "short cut at " << i << endl;
-        shortcuts.insert(make_pair(Kmer(s+i),make_pair(head,i)));
-      }
-      //cout << "final shortcut at " << (len-k) << endl;
-      shortcuts.insert(make_pair(Kmer(s+len-k), make_pair(head,len-k)));
+      addShortcuts(seq, head);
     }
   }
 
   long_split_contigs.clear();
+
+  // every contig is full now and the coverage sums are final
+  for (auto& kv : lContigs) {
+    kv.second->counts = CoverageCounts();
+  }
+
   assert(checkShortcuts());
   return make_pair(split,deleted);
 }
 
 
 
-// use:  mapper.removeShortcuts(s)
-// pre:  s.size >= k
-// post: no shortcuts map to kmers in s
-void ContigMapper::removeShortcuts(const string& s) {
+// use:  mapper.addShortcuts(seq, head)
+// pre:  seq.size() >= k, head is the head of the contig with sequence seq
+// post: the k-mers at every stride positions and the last k-mer of seq
+//       are shortcuts to head, removeShortcuts(seq) removes them again,
+//       a k-mer that is also the last one, or its twin, only maps to the end
+void ContigMapper::addShortcuts(const CompressedSequence& seq, Kmer head) {
+  size_t k = Kmer::k, len = seq.size();
+
+  Kmer last = seq.getKmer(len-k);
+  shortcuts.insert(make_pair(last, make_pair(head, len-k))); // last k-mer
+  Kmer lastrep = last.rep();
+  for (size_t i = stride; i < len-k; i += stride) {
+    Kmer km = seq.getKmer(i);
+    if (km.rep() != lastrep) {
+      shortcuts.insert(make_pair(km, make_pair(head, i)));
+    }
+  }
+}
+
+
+// use:  mapper.removeShortcuts(seq)
+// pre:  seq.size() >= k
+// post: no shortcuts map to kmers in seq
+void ContigMapper::removeShortcuts(const CompressedSequence& seq) {
   size_t k = Kmer::k;
-  const char *c = s.c_str();
 
-  for (size_t i = stride; i < s.size()-k+1; i += stride) {
-    shortcuts.erase(Kmer(c+i));
+  for (size_t i = stride; i < seq.size()-k+1; i += stride) {
+    shortcuts.erase(seq.getKmer(i));
   }
-  shortcuts.erase(Kmer(c+s.size()-k)); // erase last k-mer
+  shortcuts.erase(seq.getKmer(seq.size()-k)); // erase last k-mer
 
 }
 
@@ -1280,13 +1813,20 @@ size_t ContigMapper::writeGFA(int count1, string graphfilename, bool debug = fal
 
 
   KmerHashTable<size_t> idmap(lContigs.size());
+  vector<char> buf; // decoded sequence, reused between contigs
   //for (hmap_long_contig_t::iterator it = lContigs.begin(); it != lContigs.end(); ++it) {
   for (auto& kv : lContigs) {
     if (!debug) {assert(kv.second->ccov.isFull()); }
     id++;
     idmap.insert({kv.first,id});
-    graph << "S\t" << id << "\t" << kv.second->seq.toString()
-          << "\tLN:i:" << kv.second->seq.size()
+    const CompressedSequence& seq = kv.second->seq;
+    if (buf.size() <= seq.size()) {
+      buf.resize(seq.size()+1);
+    }
+    seq.toString(&buf[0]);
+    graph << "S\t" << id << "\t";
+    graph.write(&buf[0], seq.size());
+    graph << "\tLN:i:" << seq.size()
           << "\tXC:i:" << kv.second->coveragesum << "\n";
     if (debug) { graph << kv.first.toString() << "\n";}
   }
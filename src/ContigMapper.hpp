@@ -3,13 +3,42 @@
 
 #include "Kmer.hpp"
 #include "BlockedBloomFilter.hpp"
+#include "BloomFilterCache.hpp"
 #include <cstring> // for size_t
 #include "Contig.hpp"
 #include "CompressedCoverage.hpp"
+#include "CoverageCounts.hpp"
+#include "SequenceArena.hpp"
 #include "ContigMethods.hpp"
 #include "KmerHashTable.h"
 
 
+/*
+  Short description:
+
+  Coverage intervals buffered by one worker thread during a round of
+  mapping reads. The intervals are spread over parts by contig so each
+  part can be flushed by its own thread without two threads touching
+  the same contig.
+ */
+
+class CoverageBuffer {
+ public:
+  struct Interval {
+    CompressedCoverage *cov;
+    Contig *contig; // NULL for short contigs
+    CoverageCounts *counts; // exact counts of a short contig or NULL
+    size_t start, end; // start <= end
+  };
+
+  CoverageBuffer(size_t nparts = 1) : parts(nparts) {}
+  void add(CompressedCoverage *cov, Contig *contig, CoverageCounts *counts, size_t start, size_t end);
+  void clear();
+
+  vector<vector<Interval>> parts;
+};
+
+
 /*
   Short description:
 
@@ -28,11 +57,15 @@ class ContigMapper {
   void mapBloomFilter(const BlockedBloomFilter *bf);
 
 
-  ContigMap findContig(Kmer km, const string& s, size_t pos) const;
+  ContigMap findContig(Kmer km, const string& s, size_t pos, BloomFilterCache *cache = NULL) const;
   void mapRead(const ContigMap& cc);
+  void mapRead(const ContigMap& cc, CoverageBuffer& buf);
+  void flushCoverage(vector<CoverageBuffer>& bufs, size_t part);
 
-  bool addContig(Kmer km, const string& read, size_t pos, const string& seq);
-  void findContigSequence(Kmer km, string& s, bool& selfLoop);
+  bool addContig(Kmer km, const string& read, size_t pos, const string& seq, bool cover = true);
+  void coverAll();
+  void findContigSequence(Kmer km, string& s, bool& selfLoop, size_t& dist, bool& strand, BloomFilterCache *cache = NULL);
+  void findContigSequences(const vector<Kmer>& kms, vector<string>& seqs, vector<bool>& selfLoops) const;
 
   size_t contigCount() const;
 
@@ -52,19 +85,42 @@ class ContigMapper {
   bool checkEndKmer(Kmer b, bool& dir);
 
   bool checkShortcuts();
-  void setStride(size_t stride_) { stride = stride_; }
+  void setStride(size_t stride_);
+  size_t getStride() const { return stride; }
+  size_t shortcutCount() const { return shortcuts.size(); }
+  size_t shortcutMemory() const;
+  static size_t strideForMemory(size_t nkmers, size_t bytes);
+  static size_t memoryForKmers(size_t nkmers, bool counts, bool seqs);
+  void reserve(size_t nkmers);
+  void setCountCoverage(bool b) { countCoverage = b; }
+  void setStoreShortSequences(bool b) { storeShortSeqs = b; }
+  size_t shortSequenceCount() const { return sSeqs.size(); }
+  size_t shortSequenceMemory() const;
+  size_t shortContigMemory() const;
+  size_t longContigMemory() const;
+  size_t memory() const;
   void printState() const;
 
+  static const size_t walk_batch = 16; // walks advanced in turn by findContigSequences
+
  private:
   const BlockedBloomFilter *bf;
   size_t limit;
   size_t stride;
+  bool countCoverage; // keep exact k-mer coverage for real XC values
+  bool storeShortSeqs; // keep the sequences of short contigs instead of walking them again
 
-  void removeShortcuts(const string& s);
+  void addShortcuts(const CompressedSequence& seq, Kmer head);
+  void extendMatch(ContigMap& cc, const string& s, size_t pos) const;
+  void removeShortcuts(const CompressedSequence& seq);
+  void shortContigSequences(const vector<Kmer>& heads, vector<string>& seqs, vector<bool>& selfLoops) const;
 
   ContigMap find(Kmer km) const;
-  bool fwBfStep(Kmer km, Kmer& end, char& c, size_t& deg) const;
-  bool bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg) const;
+  bool fwBfStep(Kmer km, Kmer& end, char& c, size_t& deg, BloomFilterCache *cache = NULL) const;
+  bool bwBfStep(Kmer km, Kmer& front, char& c, size_t& deg, BloomFilterCache *cache = NULL) const;
+  bool inBloomFilter(const Kmer& rep, BloomFilterCache *cache) const {
+    return (cache != NULL) ? cache->contains(*bf, rep) : bf->contains(rep);
+  }
 
 
 
@@ -72,10 +128,16 @@ class ContigMapper {
   typedef KmerHashTable<CompressedCoverage> hmap_short_contig_t;
   typedef KmerHashTable<Contig *> hmap_long_contig_t;
   typedef KmerHashTable<pair<Kmer, size_t>> hmap_shortcut_t;
+  typedef KmerHashTable<CoverageCounts> hmap_short_counts_t;
+  typedef KmerHashTable<size_t> hmap_short_seqs_t;
 
   hmap_short_contig_t sContigs;
+  hmap_short_counts_t sCounts; // only used if countCoverage is set
+  hmap_short_seqs_t   sSeqs;   // offsets into shortSeqs, only used if storeShortSeqs is set
+  SequenceArena       shortSeqs;
   hmap_long_contig_t  lContigs;
   hmap_shortcut_t     shortcuts;
+  vector<Kmer>        strideHeads; // long contigs of fewer than k k-mers, short again in splitAllContigs
 
 };
 
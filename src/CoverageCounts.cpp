@@ -0,0 +1,170 @@
+#include <cassert>
+#include <algorithm>
+#include "CoverageCounts.hpp"
+
+
+// use:  cc = CoverageCounts(sz);
+// post: cc has sz 4-bit counters, all 0
+CoverageCounts::CoverageCounts(size_t sz) : data_(NULL), size_(sz), bits_(4) {
+  if (size_ > 0) {
+    data_ = new uint8_t[nbytes(size_, bits_)];
+    memset(data_, 0, nbytes(size_, bits_));
+  }
+}
+
+
+// use:  cc = CoverageCounts(o);
+// post: cc has a copy of the counters of o
+CoverageCounts::CoverageCounts(const CoverageCounts& o) : data_(NULL), size_(o.size_), bits_(o.bits_) {
+  if (o.data_ != NULL) {
+    data_ = new uint8_t[nbytes(size_, bits_)];
+    memcpy(data_, o.data_, nbytes(size_, bits_));
+  }
+}
+
+
+// use:  cc = o;
+// post: cc has a copy of the counters of o, its old counters are released
+CoverageCounts& CoverageCounts::operator=(const CoverageCounts& o) {
+  if (this != &o) {
+    uint8_t *data = NULL;
+    if (o.data_ != NULL) {
+      data = new uint8_t[nbytes(o.size_, o.bits_)];
+      memcpy(data, o.data_, nbytes(o.size_, o.bits_));
+    }
+    delete[] data_;
+    data_ = data;
+    size_ = o.size_;
+    bits_ = o.bits_;
+  }
+  return *this;
+}
+
+
+// use:  delete cc;
+// post: the memory of the counters has been released
+CoverageCounts::~CoverageCounts() {
+  delete[] data_;
+}
+
+
+// use:  c = cc.at(index);
+// pre:  0 <= index < cc.size()
+// post: c is the coverage of k-mer index
+uint32_t CoverageCounts::at(size_t index) const {
+  assert(index < size_);
+  switch (bits_) {
+    case 4:
+      return (data_[index >> 1] >> (4*(index & 1))) & 0x0F;
+    case 8:
+      return data_[index];
+    default: {
+      uint16_t v;
+      memcpy(&v, data_ + 2*index, 2);
+      return v;
+    }
+  }
+}
+
+
+// use:  cc.set(index, val);
+// pre:  0 <= index < cc.size(), val fits in a counter
+// post: the coverage of k-mer index is val
+void CoverageCounts::set(size_t index, uint32_t val) {
+  switch (bits_) {
+    case 4: {
+      size_t sh = 4*(index & 1);
+      data_[index >> 1] = (data_[index >> 1] & ~(0x0F << sh)) | (val << sh);
+      break;
+    }
+    case 8:
+      data_[index] = val;
+      break;
+    default: {
+      uint16_t v = val;
+      memcpy(data_ + 2*index, &v, 2);
+    }
+  }
+}
+
+
+// use:  cc.widen();
+// pre:  cc.bits() < 16
+// post: the counters are twice as wide, their values are unchanged
+void CoverageCounts::widen() {
+  assert(bits_ < 16);
+  CoverageCounts w;
+  w.size_ = size_;
+  w.bits_ = 2*bits_;
+  w.data_ = new uint8_t[nbytes(size_, w.bits_)];
+  for (size_t i = 0; i < size_; i++) {
+    w.set(i, at(i));
+  }
+  std::swap(data_, w.data_);
+  bits_ = w.bits_;
+}
+
+
+// use:  cc.add(start, end, times);
+// pre:  0 <= start <= end < cc.size()
+// post: the coverage of k-mers start,...,end has been increased by times,
+//       the counters have been widened if needed
+void CoverageCounts::add(size_t start, size_t end, size_t times) {
+  assert(start <= end);
+  assert(end < size_);
+
+  // widen once up front if the largest counter in the range would overflow
+  uint32_t top = 0;
+  for (size_t i = start; i <= end; i++) {
+    top = std::max(top, at(i));
+  }
+  while (top + times > maxAt() && bits_ < 16) {
+    widen();
+  }
+
+  uint32_t limit = maxAt();
+  for (size_t i = start; i <= end; i++) {
+    uint32_t v = at(i);
+    set(i, (v + times > limit) ? limit : v + times);
+  }
+}
+
+
+// use:  s = cc.sum(start, end);
+// pre:  0 <= start <= end < cc.size()
+// post: s is the total coverage of k-mers start,...,end
+uint64_t CoverageCounts::sum(size_t start, size_t end) const {
+  assert(start <= end);
+  assert(end < size_);
+
+  uint64_t s = 0;
+  switch (bits_) {
+    case 4: {
+      // odd ends one at a time, the bytes in between hold two counters each
+      if (start & 1) {
+        s += at(start++);
+      }
+      if ((end & 1) == 0 && end >= start) {
+        s += at(end);
+        if (end == 0) {
+          break;
+        }
+        --end;
+      }
+      for (size_t b = start >> 1; b < (end + 1) >> 1; b++) {
+        s += (data_[b] & 0x0F) + (data_[b] >> 4);
+      }
+      break;
+    }
+    case 8:
+      for (size_t i = start; i <= end; i++) {
+        s += data_[i];
+      }
+      break;
+    default:
+      for (size_t i = start; i <= end; i++) {
+        s += at(i);
+      }
+  }
+  return s;
+}
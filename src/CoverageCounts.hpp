@@ -0,0 +1,45 @@
+#ifndef BFG_COVERAGE_COUNTS_HPP
+#define BFG_COVERAGE_COUNTS_HPP
+
+#include <cstring>
+#include <stdint.h>
+
+
+/* Short description:
+ *  - Exact k-mer coverage for a contig, one counter per k-mer
+ *  - Counters start out 4 bits wide, the whole array is widened to 8 and
+ *    then 16 bits the first time a counter would overflow
+ *  - 16-bit counters saturate at max_count
+ *  - Not threadsafe, callers make sure only one thread changes a contig
+ * */
+class CoverageCounts {
+ public:
+  CoverageCounts() : data_(NULL), size_(0), bits_(0) {}
+  explicit CoverageCounts(size_t sz);
+  CoverageCounts(const CoverageCounts& o);
+  CoverageCounts& operator=(const CoverageCounts& o);
+  ~CoverageCounts();
+
+  void add(size_t start, size_t end, size_t times);
+  uint32_t at(size_t index) const;
+  uint64_t sum(size_t start, size_t end) const;
+
+  bool isEmpty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t bits() const { return bits_; }
+  size_t memory() const { return sizeof(*this) + nbytes(size_, bits_); }
+
+  static const uint32_t max_count = 65535;
+
+ private:
+  static size_t nbytes(size_t sz, size_t bits) { return (sz*bits + 7) / 8; }
+  uint32_t maxAt() const { return (1U << bits_) - 1; }
+  void set(size_t index, uint32_t val);
+  void widen();
+
+  uint8_t *data_;
+  uint32_t size_;
+  uint8_t bits_; // 4, 8 or 16
+};
+
+#endif // BFG_COVERAGE_COUNTS_HPP
@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cstdio>
+#include <sys/stat.h>
+
+#include "DuplicateSet.hpp"
+#include "hash.hpp"
+
+using namespace std;
+
+
+// the reads in a file are estimated with records of this many bytes, a short
+// fasta read or a fastq read of about 25 bases, and gzip files holding this
+// many times their size
+static const size_t min_record = 64;
+static const size_t gzip_ratio = 4;
+
+
+// use:  dups = DuplicateSet(bytes);
+// post: dups has a table of at most bytes bytes, a power of two number
+//       of slots and at least 64, and has seen no reads
+DuplicateSet::DuplicateSet(size_t bytes) : nused(0), nreads(0), ndups(0) {
+  size_t slots = 64;
+  while (2 * slots * sizeof(uint64_t) <= bytes) {
+    slots *= 2;
+  }
+  table = vector<atomic<uint64_t>>(slots);
+  for (auto& s : table) {
+    s.store(0, memory_order_relaxed);
+  }
+  mask = slots - 1;
+  maxused = slots / 4 * 3;
+}
+
+
+// use:  bytes = DuplicateSet::bytesForFiles(files);
+// post: bytes is the size of a table that has room for the reads of files,
+//       estimated from the file sizes, files that can not be read count as empty
+size_t DuplicateSet::bytesForFiles(const vector<string>& files) {
+  size_t reads = 0;
+  for (auto& fname : files) {
+    struct stat st;
+    FILE *f = fopen(fname.c_str(), "rb");
+    if (f == NULL || fstat(fileno(f), &st) != 0) {
+      if (f != NULL) {
+        fclose(f);
+      }
+      continue;
+    }
+    unsigned char h[2];
+    bool gz = fread(h, 1, 2, f) == 2 && h[0] == 0x1f && h[1] == 0x8b;
+    fclose(f);
+    reads += (gz ? gzip_ratio : 1) * (size_t) st.st_size / min_record;
+  }
+  size_t slots = 64;
+  while (slots / 4 * 3 < reads) {
+    slots *= 2;
+  }
+  return slots * sizeof(uint64_t);
+}
+
+
+// use:  c = dups.add(seq, len, buf);
+// pre:  buf is scratch space owned by the calling thread
+// post: c is the number of copies of seq[0..len) or its reverse complement
+//       added before this one, at most 3, and this copy has been counted
+size_t DuplicateSet::add(const char *seq, size_t len, string& buf) {
+  ++nreads;
+
+  // the fingerprint is taken of the smaller of the read and its reverse complement
+  const char *key = seq;
+  for (size_t i = 0, j = len; i < j; i++) {
+    --j;
+    char c = seq[j];
+    switch (c) {
+    case 'A': c = 'T'; break;
+    case 'C': c = 'G'; break;
+    case 'G': c = 'C'; break;
+    case 'T': c = 'A'; break;
+    }
+    if (c != seq[i]) {
+      if (c < seq[i]) {
+        buf.resize(len);
+        for (size_t p = 0; p < len; p++) {
+          char b = seq[len - 1 - p];
+          switch (b) {
+          case 'A': b = 'T'; break;
+          case 'C': b = 'G'; break;
+          case 'G': b = 'C'; break;
+          case 'T': b = 'A'; break;
+          }
+          buf[p] = b;
+        }
+        key = buf.c_str();
+      }
+      break;
+    }
+  }
+  uint64_t h;
+  MurmurHash3_x64_64((const void *) key, (int) len, 0, &h);
+
+  // the low bits of a slot are the copy count, 0 marks an empty slot
+  uint64_t fp = h & ~(uint64_t) 3;
+  if (fp == 0) {
+    fp = 4;
+  }
+  for (uint64_t i = (h >> 32) & mask; ; i = (i + 1) & mask) {
+    uint64_t v = table[i].load(memory_order_relaxed);
+    while (v == 0) {
+      if (nused >= maxused) {
+        return 0;
+      }
+      if (table[i].compare_exchange_weak(v, fp, memory_order_relaxed)) {
+        ++nused;
+        return 0;
+      }
+    }
+    if ((v & ~(uint64_t) 3) == fp) {
+      while ((v & 3) < 3 && !table[i].compare_exchange_weak(v, v + 1, memory_order_relaxed)) {
+      }
+      ++ndups;
+      return min<size_t>((v & 3) + 1, 3);
+    }
+  }
+}
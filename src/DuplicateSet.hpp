@@ -0,0 +1,39 @@
+#ifndef BFG_DUPLICATE_SET_HPP
+#define BFG_DUPLICATE_SET_HPP
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+
+
+/* Short description:
+ *  - Finds exact duplicate reads, a read and its reverse complement are
+ *    the same read since they have the same k-mers
+ *  - Keeps a 64-bit fingerprint of every read in an open addressing table,
+ *    the two low bits of a slot count the copies seen, up to 3
+ *  - add is threadsafe and lock free, the slots are claimed with compare and swap
+ *  - The table does not grow, when it is 3/4 full new reads are no longer
+ *    stored and are reported as seen for the first time, bytesForFiles
+ *    sizes it for the reads of the input files
+ * */
+class DuplicateSet {
+ public:
+  DuplicateSet(size_t bytes);
+
+  static size_t bytesForFiles(const std::vector<std::string>& files);
+
+  size_t add(const char *seq, size_t len, std::string& buf);
+
+  size_t reads() const { return nreads; }
+  size_t duplicates() const { return ndups; }
+  bool full() const { return nused >= maxused; }
+
+ private:
+  std::vector<std::atomic<uint64_t>> table;
+  uint64_t mask;
+  size_t maxused;
+  std::atomic<size_t> nused, nreads, ndups;
+};
+
+#endif // BFG_DUPLICATE_SET_HPP
@@ -20,21 +20,13 @@
 #include "Kmer.hpp"
 #include "KmerIterator.hpp"
 #include "BlockedBloomFilter.hpp"
+#include "ReadCache.hpp"
+#include "MappedFastq.hpp"
+#include "ReadNormalizer.hpp"
+#include "DuplicateSet.hpp"
+#include "PartitionedInserter.hpp"
 
 
-struct FilterReads_ProgramOptions {
-  bool verbose;
-  size_t threads, read_chunksize, k, nkmers, nkmers2;
-  FILE *outputfile;
-  string output;
-  size_t bf, bf2;
-  uint32_t seed;
-  bool ref;
-  vector<string> files;
-  FilterReads_ProgramOptions() : verbose(false), threads(1), k(0), nkmers(0), nkmers2(0), \
-    outputfile(NULL), bf(4), bf2(8), seed(0), read_chunksize(10000), ref(false) {}
-};
-
 // use:  FilterReads_PrintUsage();
 // pre:
 // post: Information about how to filter reads has been printed to cerr
@@ -46,14 +38,30 @@ void FilterReads_PrintUsage() {
        "  -v, --verbose               Print lots of messages during run" << endl <<
        "  -t, --threads=INT           Number of threads to use (default 1)" << endl <<
        "  -c, --chunk-size=INT        Read chunksize to split betweeen threads (default 10000 for multithreaded else 1)" << endl <<
-       "  -k, --kmer-size=INT         Size of k-mers, the same value as used for filtering reads" << endl <<
+       "  -k, --kmer-size=INT[,INT..] Size of k-mers, the same value as used for filtering reads," << endl <<
+       "                              several sizes give one filter each from one pass over the files, named" << endl <<
+       "                              like the output with .k<size> before the extension" << endl <<
        "      --ref                   Reference mode, no filtering use only num_kmers and bloom-bits" << endl <<
        "  -n, --num-kmers=LONG        Estimated number of k-mers (upper bound)" << endl <<
        "  -N, --num-kmer2=LONG        Estimated number of k-mers in genome (upper bound)" << endl <<
        "  -o, --output=STRING         Filename for output" << endl <<
        "  -b, --bloom-bits=INT        Number of bits to use in Bloom filter (default=4)" << endl <<
        "  -B, --bloom-bits2=INT       Number of bits to use in second Bloom filter (default=8)" << endl <<
-       "  -s, --seed=INT              Seed used for randomization (default time based)"
+       "  -s, --seed=INT              Seed used for randomization (default time based)" << endl <<
+       "      --streams=INT           Number of input files read at once, each on its own thread (default: number of threads)" << endl <<
+       "      --min-qual=INT          Mask bases with a lower Phred quality as N, no k-mer covers them (default: 0, off)" << endl <<
+       "      --quality-scale=INT     Offset of the quality characters, 33 or 64 (default: guessed from the reads)" << endl <<
+       "      --norm-cov=INT          Drop reads whose median k-mer count in the reads kept so far is INT or more, at most 255 (default: 0, off)" << endl <<
+       "      --norm-memory=INT       Memory in MB for the k-mer counts of --norm-cov (default: 1 byte per k-mer of num-kmers)" << endl <<
+       "      --norm-out=STRING       Write the reads kept by --norm-cov to this fasta file" << endl <<
+       "      --dedup                 Put the k-mers of exact duplicate reads straight into the second filter" << endl <<
+       "      --dedup-memory=INT      Memory in MB for the read fingerprints of --dedup (default: enough for the reads, estimated from the file sizes)" << endl <<
+       "      --max-fpr=FLOAT         Stop when the false positive rate of a filter passes FLOAT and print the size it needs" << endl <<
+       "                              (default: 0, only warn when it passes 4 times the rate it was sized for)" << endl <<
+       "      --max-memory=INT        Memory in MB for the filters and sketches, picks num-kmers and num-kmers2 when they" << endl <<
+       "                              are not given and lowers the bloom bits when they do not fit (default: 0, no limit)" << endl <<
+       "      --partitioned           Buffer the k-mers of each thread and insert them into one 2MB part of the filters" << endl <<
+       "                              at a time, faster when the filters are much larger than the CPU cache"
        << endl << endl;
 }
 
@@ -76,6 +84,17 @@ void FilterReads_ParseOptions(int argc, char **argv, FilterReads_ProgramOptions&
     {"bloom-bits2", required_argument, 0, 'B'},
     {"seed",        required_argument, 0, 's'},
     {"ref",         no_argument,       0,  0 },
+    {"streams",     required_argument, 0,  0 },
+    {"min-qual",    required_argument, 0,  0 },
+    {"quality-scale", required_argument, 0,  0 },
+    {"norm-cov",    required_argument, 0,  0 },
+    {"norm-memory", required_argument, 0,  0 },
+    {"norm-out",    required_argument, 0,  0 },
+    {"dedup",       no_argument,       0,  0 },
+    {"dedup-memory", required_argument, 0,  0 },
+    {"max-fpr",     required_argument, 0,  0 },
+    {"max-memory",  required_argument, 0,  0 },
+    {"partitioned", no_argument,       0,  0 },
     {0,             0,                 0,  0 }
   };
 
@@ -86,6 +105,28 @@ void FilterReads_ParseOptions(int argc, char **argv, FilterReads_ProgramOptions&
     case 0:
       if (strcmp(long_options[option_index].name, "ref") == 0) {
         opt.ref = true;
+      } else if (strcmp(long_options[option_index].name, "streams") == 0) {
+        opt.streams = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "min-qual") == 0) {
+        opt.min_qual = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "quality-scale") == 0) {
+        opt.qual_scale = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "norm-cov") == 0) {
+        opt.norm_cov = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "norm-memory") == 0) {
+        opt.norm_memory = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "norm-out") == 0) {
+        opt.norm_out = optarg;
+      } else if (strcmp(long_options[option_index].name, "dedup") == 0) {
+        opt.dedup = true;
+      } else if (strcmp(long_options[option_index].name, "dedup-memory") == 0) {
+        opt.dedup_memory = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "max-fpr") == 0) {
+        opt.max_fpr = atof(optarg);
+      } else if (strcmp(long_options[option_index].name, "max-memory") == 0) {
+        opt.max_memory = atoi(optarg);
+      } else if (strcmp(long_options[option_index].name, "partitioned") == 0) {
+        opt.partitioned = true;
       }
       break;
     case 'v':
@@ -94,9 +135,17 @@ void FilterReads_ParseOptions(int argc, char **argv, FilterReads_ProgramOptions&
     case 't':
       opt.threads = atoi(optarg);
       break;
-    case 'k':
-      opt.k = atoi(optarg);
+    case 'k': {
+      // a comma separated list of k-mer sizes, the first is opt.k
+      opt.ks.clear();
+      stringstream ks(optarg);
+      string kstr;
+      while (getline(ks, kstr, ',')) {
+        opt.ks.push_back(atoi(kstr.c_str()));
+      }
+      opt.k = opt.ks.empty() ? 0 : opt.ks[0];
       break;
+    }
     case 'n':
       ss << optarg;
       ss >> opt.nkmers;
@@ -131,6 +180,117 @@ void FilterReads_ParseOptions(int argc, char **argv, FilterReads_ProgramOptions&
 }
 
 
+// use:  fname = FilterReads_OutputName(opt, k);
+// pre:  opt.ks has the k-mer sizes to filter for
+// post: fname is the file the filter for k is written to, the output
+//       with .k<k> before the extension when there are several k-mer sizes
+string FilterReads_OutputName(const FilterReads_ProgramOptions& opt, size_t k) {
+  if (opt.ks.size() <= 1) {
+    return opt.output;
+  }
+  size_t dot = opt.output.rfind('.'), slash = opt.output.rfind('/');
+  if (dot == string::npos || (slash != string::npos && dot < slash)) {
+    dot = opt.output.size();
+  }
+  return opt.output.substr(0, dot) + ".k" + to_string(k) + opt.output.substr(dot);
+}
+
+
+// use:  b = FilterReads_CheckNormalization(opt);
+// pre:  opt contains parameters for "filtering reads"
+// post: (b == true)  <==>  the normalization parameters are valid
+bool FilterReads_CheckNormalization(const FilterReads_ProgramOptions& opt) {
+  bool ret = true;
+  if (opt.norm_cov > 255) {
+    cerr << "Error: Invalid norm-cov: " << opt.norm_cov << ", the counts stop at 255" << endl;
+    ret = false;
+  }
+  if (!opt.norm_out.empty()) {
+    FILE *fp;
+    if (opt.norm_cov == 0) {
+      cerr << "Error: --norm-out needs --norm-cov" << endl;
+      ret = false;
+    } else if ((fp = fopen(opt.norm_out.c_str(), "w")) == NULL) {
+      cerr << "Error: Could not open file for writing: " << opt.norm_out << endl;
+      ret = false;
+    } else {
+      fclose(fp);
+    }
+  }
+  return ret;
+}
+
+
+// use:  b = FilterReads_PlanMemory(opt);
+// pre:  opt contains parameters for "filtering reads", opt.max_memory > 0
+// post: (b == true)  <==>  the filters and sketches fit in max_memory MB,
+//       the sketches not given have max_memory/8 MB each, num-kmers and num-kmers2
+//       not given have the rest, with num-kmers twice num-kmers2 when both are missing,
+//       and bloom bits too large for the given k-mer counts have been lowered with a warning
+bool FilterReads_PlanMemory(FilterReads_ProgramOptions& opt) {
+  if (opt.bf == 0 || (opt.bf2 == 0 && !opt.ref)) {
+    return true; // CheckOptions reports these
+  }
+  if (opt.norm_cov > 0 && opt.norm_memory == 0) {
+    opt.norm_memory = max<size_t>(opt.max_memory / 8, 1);
+  }
+  if (opt.dedup && opt.dedup_memory == 0) {
+    opt.dedup_memory = max<size_t>(opt.max_memory / 8, 1);
+  }
+  size_t sketches = ((opt.norm_cov > 0) ? opt.norm_memory : 0) + (opt.dedup ? opt.dedup_memory : 0);
+  if (sketches >= opt.max_memory) {
+    cerr << "Error: --norm-memory and --dedup-memory leave nothing of --max-memory " << opt.max_memory
+         << " for the bloom filters" << endl;
+    return false;
+  }
+
+  // the filters are never larger than this, both are alive until the end
+  size_t bits = (opt.max_memory - sketches) << 23;
+  size_t b = opt.bf, B = opt.ref ? 0 : opt.bf2;
+  if (opt.ref) {
+    opt.nkmers2 = max<size_t>(opt.nkmers2, 1); // there is no second filter
+  }
+  if (opt.nkmers == 0 && (opt.nkmers2 == 0 || opt.ref)) {
+    if (opt.ref) {
+      opt.nkmers = bits / b;
+    } else {
+      opt.nkmers2 = bits / (2 * b + B);
+      opt.nkmers = 2 * opt.nkmers2;
+    }
+  } else if (opt.nkmers == 0 || (opt.nkmers2 == 0 && !opt.ref)) {
+    size_t used = (opt.nkmers == 0) ? opt.nkmers2 * B : opt.nkmers * b;
+    if (used >= bits) {
+      cerr << "Error: The bloom filter for " << ((opt.nkmers == 0) ? opt.nkmers2 : opt.nkmers)
+           << " k-mers leaves nothing of --max-memory " << opt.max_memory << " for the other one" << endl;
+      return false;
+    }
+    if (opt.nkmers == 0) {
+      opt.nkmers = (bits - used) / b;
+    } else {
+      opt.nkmers2 = (bits - used) / B;
+    }
+  }
+
+  size_t need = opt.nkmers * b + (opt.ref ? 0 : opt.nkmers2 * B);
+  if (need > bits) {
+    // fewer bits per k-mer give more false positives but keep the run in its budget
+    opt.bf = max<size_t>(b * bits / need, 1);
+    if (!opt.ref) {
+      opt.bf2 = max<size_t>(B * bits / need, 1);
+    }
+    need = opt.nkmers * opt.bf + (opt.ref ? 0 : opt.nkmers2 * opt.bf2);
+    if (need > bits) {
+      cerr << "Error: The bloom filters for " << opt.nkmers << " and " << opt.nkmers2 << " k-mers need at least "
+           << (need >> 23) + 1 << " MB, more than --max-memory " << opt.max_memory << endl;
+      return false;
+    }
+    cerr << "Warning: Lowering the bloom bits to " << opt.bf << " and " << opt.bf2
+         << " so the filters fit in --max-memory" << endl;
+  }
+  return true;
+}
+
+
 // use:  b = FilterReads_CheckOptions(opt);
 // pre:  opt contains parameters for "filtering reads"
 // post: (b == true)  <==>  the parameters are valid
@@ -158,9 +318,24 @@ bool FilterReads_CheckOptions(FilterReads_ProgramOptions& opt) {
       opt.read_chunksize = 1;*/
   }
 
-  if (opt.k <= 0 || opt.k >= MAX_KMER_SIZE) {
-    cerr << "Error, invalid value for kmer-size: " << opt.k << endl;
-    cerr << "Values must be between 1 and " << (MAX_KMER_SIZE-1) << endl;
+  if (opt.ks.empty()) {
+    opt.ks.push_back(opt.k);
+  }
+  for (size_t i = 0; i < opt.ks.size(); i++) {
+    if (opt.ks[i] <= 0 || opt.ks[i] >= MAX_KMER_SIZE) {
+      cerr << "Error, invalid value for kmer-size: " << opt.ks[i] << endl;
+      cerr << "Values must be between 1 and " << (MAX_KMER_SIZE-1) << endl;
+      ret = false;
+    }
+    for (size_t j = 0; j < i; j++) {
+      if (opt.ks[j] == opt.ks[i]) {
+        cerr << "Error, kmer-size " << opt.ks[i] << " is given twice" << endl;
+        ret = false;
+      }
+    }
+  }
+
+  if (opt.max_memory > 0 && !FilterReads_PlanMemory(opt)) {
     ret = false;
   }
 
@@ -176,7 +351,19 @@ bool FilterReads_CheckOptions(FilterReads_ProgramOptions& opt) {
     ret = false;
   }
 
-  opt.outputfile = fopen(opt.output.c_str(), "wb");
+  // with several k-mer sizes the other files are opened when their filter is written
+  for (size_t i = 1; i < opt.ks.size(); i++) {
+    string fname = FilterReads_OutputName(opt, opt.ks[i]);
+    FILE *fp = fopen(fname.c_str(), "wb");
+    if (fp == NULL) {
+      cerr << "Error: Could not open file for writing, " << fname << endl;
+      ret = false;
+    } else {
+      fclose(fp);
+    }
+  }
+
+  opt.outputfile = fopen(FilterReads_OutputName(opt, opt.k).c_str(), "wb");
 
   if (opt.outputfile == NULL) {
     cerr << "Error: Could not open file for writing, " << opt.outputfile << endl;
@@ -214,6 +401,23 @@ bool FilterReads_CheckOptions(FilterReads_ProgramOptions& opt) {
     opt.nkmers2 = 0;
   }
 
+  if (opt.streams == 0) {
+    opt.streams = opt.threads;
+  }
+
+  if (opt.max_fpr < 0 || opt.max_fpr >= 1) {
+    cerr << "Error: Invalid max-fpr: " << opt.max_fpr << ", need a number between 0 and 1" << endl;
+    ret = false;
+  }
+
+  if (opt.min_qual > 0 && ret && !CheckQualityScale(opt.files, opt.min_qual, opt.qual_scale, opt.verbose)) {
+    ret = false;
+  }
+
+  if (!FilterReads_CheckNormalization(opt)) {
+    ret = false;
+  }
+
   return ret;
 }
 
@@ -223,9 +427,22 @@ bool FilterReads_CheckOptions(FilterReads_ProgramOptions& opt) {
 // post: Information about the two Bloom Filters has been printed to cerr
 void FilterReads_PrintSummary(const FilterReads_ProgramOptions& opt) {
   double fp;
-  cerr << "Kmer size: " << opt.k << endl
-       << "Chunksize: " << opt.read_chunksize << endl
-       << "Using bloom filter size: " << opt.bf << " bits per element" << endl
+  cerr << "Kmer size: " << opt.k;
+  for (size_t i = 1; i < opt.ks.size(); i++) {
+    cerr << "," << opt.ks[i];
+  }
+  cerr << endl
+       << "Chunksize: " << opt.read_chunksize << endl;
+  if (opt.min_qual > 0) {
+    cerr << "Masking bases with quality below " << opt.min_qual << " (quality scale " << opt.qual_scale << ")" << endl;
+  }
+  if (opt.norm_cov > 0) {
+    cerr << "Normalizing to k-mer coverage " << opt.norm_cov << endl;
+  }
+  if (opt.dedup) {
+    cerr << "Skipping duplicate reads" << endl;
+  }
+  cerr << "Using bloom filter size: " << opt.bf << " bits per element" << endl
        << "Estimated false positive rate: ";
   fp = pow(pow(.5,log(2.0)),(double) opt.bf);
   cerr << fp << endl;
@@ -239,16 +456,18 @@ void FilterReads_PrintSummary(const FilterReads_ProgramOptions& opt) {
 }
 
 
-// use:  FilterReads_Normal(opt);
+// use:  FilterReads_Filter(opt, bf, cache, replay);
 // pre:  opt has information about Kmer size, Bloom Filter sizes,
 //       lower bound of Kmer count, upper bound of Kmer count
-//       input file name strings and outputfile
-// post: Input files have been opened and and all the reads
+//       and input file name strings, cache is NULL or has been created,
+//       if replay is true cache has been written by an earlier call
+// post: Input files, or the cache if replay is true, have been read and all the reads
 //       have been broken into kmers of given Kmer size.
 //       The kmers have been filtered through two Bloom Filters
-//       and those that survived through the second Bloom Filter have
-//       been written into the outputfile
-void FilterReads_Normal(const FilterReads_ProgramOptions& opt) {
+//       and bf is the filter with those that survived through the second one,
+//       if cache is not NULL and replay is false every read that passed the
+//       normalization has been written to it
+void FilterReads_Filter(const FilterReads_ProgramOptions& opt, BlockedBloomFilter& bf, ReadCache *cache, bool replay) {
   /**
    *  outline of algorithm
    *    create two bloom filters, BF and BF2
@@ -269,6 +488,10 @@ void FilterReads_Normal(const FilterReads_ProgramOptions& opt) {
 
   BlockedBloomFilter BF(opt.nkmers, (size_t) opt.bf, seed);
   BlockedBloomFilter BF2(opt.nkmers2, (size_t) opt.bf2, seed + 1); // use different seeds
+  const size_t fill_samples = 4096; // blocks counted after every chunk
+  if (opt.verbose) {
+    cerr << "Bloom filters on " << largePageSummary() << endl;
+  }
 
   bool done = false;
   char name[8192];
@@ -277,122 +500,435 @@ void FilterReads_Normal(const FilterReads_ProgramOptions& opt) {
   uint64_t n_read = 0;
   atomic<uint64_t> num_kmers(0), num_ins(0);
 
-  FastqFile FQ(opt.files);
+  // the order of the reads does not matter for the filters, only for the cache
+  atomic<uint64_t> n_mapped(0);
+  char min_qual = (opt.min_qual > 0) ? (char) (opt.qual_scale + opt.min_qual) : 0;
+
+  // reads past the target coverage are dropped before they are chunked,
+  // on the main thread in file order while the workers filter the last chunk
+  ReadNormalizer *norm = NULL;
+  FILE *normout = NULL;
+  if (opt.norm_cov > 0 && !replay) {
+    size_t bytes = (opt.norm_memory > 0) ? (opt.norm_memory << 20) : opt.nkmers;
+    norm = new ReadNormalizer(bytes, opt.norm_cov, seed + 2);
+    if (!opt.norm_out.empty()) {
+      normout = fopen(opt.norm_out.c_str(), "w");
+    }
+  }
+
+  // the second copy of a read has all its k-mers in the first filter, or about to be,
+  // so they go straight to the second one, later copies add nothing and are skipped
+  DuplicateSet *dups = NULL;
+  if (opt.dedup && !replay) {
+    dups = new DuplicateSet((opt.dedup_memory > 0) ? (opt.dedup_memory << 20) : DuplicateSet::bytesForFiles(opt.files));
+  }
   vector<string> readv;
 
-  // Main worker thread
-  auto worker_function = [&](vector<string>::const_iterator a,
-                             vector<string>::const_iterator b) {
-    uint64_t l_num_kmers = 0, l_num_ins = 0;
-    // for each input
-    for (auto x = a; x != b; ++x) {
-      KmerIterator iter, iterend;
-      iter = KmerIterator(x->c_str());
-      // for each k-mer
+  // use:  check_fill();
+  // post: the filters have been sampled, a filter whose false positive rate passed
+  //       max_fpr has stopped the run, or past 4 times its design rate has been warned
+  //       about once, with the number of k-mers it already holds
+  bool overfull[2] = {false, false};
+  auto check_fill = [&]() {
+    for (size_t i = 0; i < (opt.ref ? 1 : 2); i++) {
+      const BlockedBloomFilter& F = (i == 0) ? BF : BF2;
+      size_t bits = (i == 0) ? opt.bf : opt.bf2;
+      double fill, maxfill, fp = F.sample(fill_samples, fill, maxfill);
+      double limit = (opt.max_fpr > 0) ? opt.max_fpr : 4 * pow(pow(.5, log(2.0)), (double) bits);
+      if (fp <= limit || overfull[i]) {
+        continue;
+      }
+      overfull[i] = true;
+      // the filter keeps its false positive rate with twice the k-mers it holds now
+      size_t n = F.estimate(fill);
+      cerr << ((opt.max_fpr > 0) ? "Error" : "Warning") << ": Bloom filter " << (i + 1) << " is overfull after "
+           << (n_read + n_mapped) << " reads, " << (100.0 * fill) << "% of its bits are set (fullest block "
+           << (100.0 * maxfill) << "%) and its false positive rate is " << fp << endl
+           << "It holds about " << n << " k-mers, use at least " << ((i == 0) ? "-n " : "-N ") << 2 * n
+           << ", more if the reads are not done" << endl;
+      if (opt.max_fpr > 0) {
+        exit(1);
+      }
+    }
+  };
+
+  // with several k-mer sizes the cache is replayed for the others, so it keeps the second copies,
+  // the reads are cached whole and split into windows again for every k
+  bool cache_twice = opt.ks.size() > 1;
+  if (replay && !cache->rewind()) {
+    cerr << "Error reading the read cache" << endl;
+    exit(1);
+  }
+
+  // with --partitioned every thread buffers its k-mers in its own inserter, that lives
+  // through all the chunks so its buffers are only allocated once
+  vector<PartitionedInserter *> inserters;
+  if (opt.partitioned) {
+    for (size_t i = 0; i < opt.threads; i++) {
+      inserters.push_back(new PartitionedInserter(BF, opt.ref ? NULL : &BF2));
+    }
+  }
+
+  // use:  filter_kmers(iter, l_num_kmers, l_num_ins, twice, id);
+  // pre:  twice is true if the k-mers of iter are from a second copy of a read,
+  //       id is the number of the thread
+  // post: the k-mers of iter have been run through the filters and counted,
+  //       with --partitioned they are buffered until flush_kmers(id, l_num_ins)
+  auto filter_kmers = [&](KmerIterator& iter, uint64_t& l_num_kmers, uint64_t& l_num_ins, bool twice, size_t id) {
+    KmerIterator iterend;
+    if (opt.partitioned) {
+      PartitionedInserter *ins = inserters[id];
       for (; iter != iterend; ++iter) {
         ++l_num_kmers;
-        Kmer km = iter->first;
-        Kmer rep = km.rep();
-        if (!opt.ref) {
-          // check first bloom filter for rep
-          size_t r = BF.search(rep);
-          if (r == 0) {
-            // if contains rep, insert into second bloom filter
-            if (!BF2.contains(rep)) {
-              BF2.insert(rep);
-              ++l_num_ins;
-            }
-          } else {
-            if (BF.insert(rep) == r) {
-              ++l_num_ins;
-            } else {
-              /*if (opt.verbose) {
-                cerr << "clash!" << endl;
-                }*/
-              BF2.insert(rep); // better safe than sorry
-            }
+        if (twice) {
+          ins->addTwice(iter->first.rep());
+        } else {
+          ins->add(iter->first.rep());
+        }
+      }
+      return;
+    }
+    // for each k-mer
+    for (; iter != iterend; ++iter) {
+      ++l_num_kmers;
+      Kmer km = iter->first;
+      Kmer rep = km.rep();
+      if (twice) {
+        if (!BF2.contains(rep)) {
+          BF2.insert(rep);
+          ++l_num_ins;
+        }
+      } else if (!opt.ref) {
+        // check first bloom filter for rep
+        size_t r = BF.search(rep);
+        if (r == 0) {
+          // if contains rep, insert into second bloom filter
+          if (!BF2.contains(rep)) {
+            BF2.insert(rep);
+            ++l_num_ins;
           }
         } else {
-          if (!BF.contains(rep)) {
-            BF.insert(rep);
+          if (BF.insert(rep) == r) {
             ++l_num_ins;
+          } else {
+            /*if (opt.verbose) {
+              cerr << "clash!" << endl;
+              }*/
+            BF2.insert(rep); // better safe than sorry
           }
         }
+      } else {
+        if (!BF.contains(rep)) {
+          BF.insert(rep);
+          ++l_num_ins;
+        }
       }
     }
+  };
+
+  // use:  flush_kmers(id, l_num_ins);
+  // post: the k-mers buffered by thread id are in the filters and counted in l_num_ins
+  auto flush_kmers = [&](size_t id, uint64_t& l_num_ins) {
+    if (opt.partitioned) {
+      size_t before = inserters[id]->inserted();
+      inserters[id]->flush();
+      l_num_ins += inserters[id]->inserted() - before;
+    }
+  };
+
+  // Main worker thread, the reads from twice on are second copies
+  auto worker_function = [&](vector<string>::const_iterator a,
+                             vector<string>::const_iterator b,
+                             vector<string>::const_iterator twice, size_t id) {
+    uint64_t l_num_kmers = 0, l_num_ins = 0;
+    // for each input
+    for (auto x = a; x != b; ++x) {
+      KmerIterator iter(x->c_str(), x->size());
+      filter_kmers(iter, l_num_kmers, l_num_ins, x >= twice, id);
+    }
+    flush_kmers(id, l_num_ins);
     // atomic adds
     num_kmers += l_num_kmers;
     num_ins += l_num_ins;
   };
 
-  while (!done) {
-    readv.clear();
+  // Worker for the records that start in bytes [begin, end) of a mapped file
+  // records longer than max_window are left in longpos for all the threads to share
+  auto mapped_worker = [&](const MappedFastq& mf, size_t begin, size_t end, vector<size_t> *longpos, size_t id) {
+    uint64_t l_num_kmers = 0, l_num_ins = 0, l_num_reads = 0;
+    string buf, dupbuf;
+    const char *seq;
+    size_t len, pos = mf.sync(begin), start = pos;
+    while (mf.next(pos, end, seq, len, buf)) {
+      if (len > max_window && opt.threads > 1) {
+        longpos->push_back(start);
+      } else {
+        size_t copies = (dups != NULL) ? dups->add(seq, len, dupbuf) : 0;
+        if (copies == 0 || (copies == 1 && !opt.ref)) {
+          KmerIterator iter(seq, len);
+          filter_kmers(iter, l_num_kmers, l_num_ins, copies == 1, id);
+        }
+      }
+      ++l_num_reads;
+      start = pos;
+    }
+    flush_kmers(id, l_num_ins);
+    // atomic adds
+    num_kmers += l_num_kmers;
+    num_ins += l_num_ins;
+    n_mapped += l_num_reads;
+  };
+
+  // Worker for one window of a long record
+  auto window_worker = [&](const char *seq, size_t len, size_t id) {
+    uint64_t l_num_kmers = 0, l_num_ins = 0;
+    KmerIterator iter(seq, len);
+    filter_kmers(iter, l_num_kmers, l_num_ins, false, id);
+    flush_kmers(id, l_num_ins);
+    // atomic adds
+    num_kmers += l_num_kmers;
+    num_ins += l_num_ins;
+  };
+
+  // Uncompressed files are parsed in place, each thread takes a part of the file.
+  // The reads of the rest are copied into chunks, as they are when they are cached
+  vector<string> files;
+  for (auto& fname : opt.files) {
+    MappedFastq mf;
+    if (replay) {
+      break; // the reads come from the cache
+    }
+    if (cache != NULL || norm != NULL || !mf.open(fname) || (min_qual > 0 && mf.isFastq())) {
+      files.push_back(fname);
+      continue;
+    }
+    vector<thread> workers;
+    vector<vector<size_t>> longpos(opt.threads);
+    for (size_t i = 0; i < opt.threads; i++) {
+      workers.push_back(thread(mapped_worker, cref(mf), mf.size() * i / opt.threads, mf.size() * (i+1) / opt.threads, &longpos[i], i));
+    }
+    for (auto &t : workers) {
+      t.join();
+    }
+
+    // each long record is split into one window per thread, overlapping by k-1 bases
+    string buf;
+    const char *seq;
+    size_t len;
+    for (auto &v : longpos) {
+      for (size_t pos : v) {
+        size_t end = pos + 1;
+        mf.next(pos, end, seq, len, buf);
+        size_t nkmers = len - opt.k + 1;
+        workers.clear();
+        for (size_t i = 0; i < opt.threads; i++) {
+          size_t a = nkmers * i / opt.threads, b = nkmers * (i+1) / opt.threads;
+          workers.push_back(thread(window_worker, seq + a, b - a + opt.k - 1, i));
+        }
+        for (auto &t : workers) {
+          t.join();
+        }
+      }
+    }
+    check_fill();
+  }
+  done = files.empty() && !replay;
+
+  // the order of the reads does not matter for the filters, only for the cache
+  FastqFile FQ(files, opt.threads, (cache == NULL) ? opt.streams : 1, min_qual);
+
+  // use:  more = read_chunk(v, twice);
+  // post: v holds the next chunk of reads, the second copies of reads
+  //       from index twice on, more is false if the files are done
+  vector<string> twicev;
+  string dupbuf;
+  auto read_chunk = [&](vector<string>& v, size_t& twice) {
+    v.clear();
+    twicev.clear();
     size_t reads_now = 0;
+    bool more = true;
     while (reads_now < read_chunksize) {
-      if (FQ.read_next(name, &name_len, s, &len, NULL, NULL) >= 0) {
-        readv.emplace_back(s);
+      int r = replay ? cache->read_next(s) : FQ.read_next(name, &name_len, s, &len, NULL, NULL);
+      if (r < -1 && replay) {
+        cerr << "Error reading the read cache" << endl;
+        exit(1);
+      } else if (r == -3) {
+        exit(1); // a corrupt input file, it has been reported
+      }
+      if (r >= 0) {
         ++n_read;
+        if (dups != NULL && s.size() <= max_window) {
+          size_t copies = dups->add(s.c_str(), s.size(), dupbuf);
+          if (copies > 0) {
+            if (copies == 1 && !opt.ref) {
+              if (cache != NULL && cache_twice && !cache->write(s)) {
+                cerr << "Error writing the read cache" << endl;
+                exit(1);
+              }
+              twicev.push_back(s);
+              ++reads_now;
+            }
+            continue;
+          }
+        }
+        if (norm != NULL) {
+          if (!norm->keep(s)) {
+            continue;
+          }
+          if (normout != NULL) {
+            fprintf(normout, ">%s\n%s\n", name, s.c_str());
+          }
+        }
+        // the reads are packed as they are read, while the workers filter the last chunk
+        if (cache != NULL && !replay && !cache->write(s)) {
+          cerr << "Error writing the read cache" << endl;
+          exit(1);
+        }
         ++reads_now;
+        if (splitWindows(v, s, opt.k) > 1) {
+          break; // a long record fills the chunk
+        }
       } else {
-        done = true;
+        more = false;
         break;
       }
     }
+    twice = v.size();
+    for (auto &x : twicev) {
+      v.push_back(move(x));
+    }
+    return more;
+  };
 
+  vector<string> nextv;
+  size_t twice = 0, nexttwice = 0;
+  if (!done) {
+    done = !read_chunk(readv, twice);
+  }
+  while (!readv.empty()) {
     vector<thread> workers;
-    // create worker threads
+    // create worker threads, each gets about the same number of bases
     auto rit = readv.begin();
-    size_t batch_size = readv.size()/opt.threads;
-    size_t leftover   = readv.size()%opt.threads;
+    vector<size_t> ends = balanceBases(readv, opt.threads);
     for (size_t i = 0; i < opt.threads; i++) {
-      size_t jump = batch_size + ((i < leftover ) ? 1 : 0);
-      auto rit_end(rit);
-      advance(rit_end, jump);
-      workers.push_back(thread(worker_function, rit, rit_end));
+      auto rit_end = readv.begin() + ends[i];
+      workers.push_back(thread(worker_function, rit, rit_end, readv.cbegin() + twice, i));
       rit = rit_end;
     }
 
     assert(rit==readv.end());
 
+    // the next chunk is read while the workers filter this one
+    nextv.clear();
+    nexttwice = 0;
+    if (!done) {
+      done = !read_chunk(nextv, nexttwice);
+    }
+
     for (auto &t : workers) {
       t.join();
     }
+    check_fill();
+    readv.swap(nextv);
+    twice = nexttwice;
   }
 
   FQ.close();
   if (opt.verbose) {
     cerr << "Closed all fasta/fastq files" << endl;
 
-    cerr << "processed " << num_kmers << " kmers in " << n_read  << " reads"<< endl;
+    cerr << "processed " << num_kmers << " kmers in " << (n_read + n_mapped) << " reads"<< endl;
+    if (norm != NULL) {
+      cerr << "normalization kept " << norm->kept() << " of " << norm->reads() << " reads" << endl;
+    }
+    if (dups != NULL) {
+      cerr << "duplicates: " << dups->duplicates() << " of " << dups->reads() << " reads ("
+           << (100.0 * dups->duplicates()) / max<size_t>(dups->reads(), 1) << "%)";
+      if (dups->full()) {
+        cerr << ", the fingerprint table filled up, increase --dedup-memory";
+      }
+      cerr << endl;
+    }
     cerr << "found " << num_ins << " non-filtered kmers" << endl;
 
-    cerr << "Writing bloom filter to " << opt.output << endl
-         << "Bloom filter size is " << num_ins << endl;
+    double fill, maxfill, fp;
+    fp = BF.sample(SIZE_MAX, fill, maxfill);
+    cerr << "Bloomfilter 1 count: " << BF.count() << ", " << (100.0 * fill) << "% bits set, fullest block "
+         << (100.0 * maxfill) << "%, false positive rate " << fp << endl;
+    if (!opt.ref) {
+      fp = BF2.sample(SIZE_MAX, fill, maxfill);
+      cerr << "Bloomfilter 2 count: " << BF2.count() << ", " << (100.0 * fill) << "% bits set, fullest block "
+           << (100.0 * maxfill) << "%, false positive rate " << fp << endl;
+    }
   }
 
+  if (normout != NULL) {
+    fclose(normout);
+  }
+  delete norm;
+  delete dups;
+  for (auto ins : inserters) {
+    delete ins;
+  }
 
-  // First write metadata for bloom filter to opt.outputfile,
-  // then the actual filter
   if (!opt.ref) {
-    if (!BF2.WriteBloomFilter(opt.outputfile)) {
-      cerr << "Error writing data to file: " << opt.output << endl;
-    }
+    bf.swap(BF2);
   } else {
-    if (!BF.WriteBloomFilter(opt.outputfile)) {
-      cerr << "Error writing data to file: " << opt.output << endl;
-    }
+    bf.swap(BF);
   }
-  fclose(opt.outputfile);
+}
 
-  if (opt.verbose) {
-    cerr << " done" << endl;
 
-    cerr << "Bloomfilter 1 count: " << BF.count() << endl;
-    if (!opt.ref) {
-      cerr << "Bloomfilter 2 count: " << BF2.count() << endl;
+// use:  FilterReads_Normal(opt);
+// pre:  opt has information about Kmer size, Bloom Filter sizes,
+//       lower bound of Kmer count, upper bound of Kmer count
+//       input file name strings and outputfile
+// post: The reads have been filtered with FilterReads_Filter and the
+//       resulting Bloom Filter has been written into the outputfile,
+//       with several k-mer sizes the reads have been parsed once into
+//       a read cache for the first one and every k has its own file
+void FilterReads_Normal(const FilterReads_ProgramOptions& opt) {
+  ReadCache cache;
+  string cachefile = opt.output + ".reads.tmp";
+  if (opt.ks.size() > 1 && !cache.create(cachefile)) {
+    cerr << "Error: Could not open file for writing: " << cachefile << endl;
+    exit(1);
+  }
+
+  for (size_t i = 0; i < opt.ks.size(); i++) {
+    FilterReads_ProgramOptions kopt = opt;
+    kopt.k = opt.ks[i];
+    Kmer::set_k(kopt.k);
+    if (opt.verbose && opt.ks.size() > 1) {
+      cerr << "Filtering k-mers of size " << kopt.k << endl;
+    }
+
+    BlockedBloomFilter bf;
+    FilterReads_Filter(kopt, bf, (opt.ks.size() > 1) ? &cache : NULL, i > 0);
+
+    string fname = FilterReads_OutputName(opt, kopt.k);
+    FILE *fp = (i == 0) ? opt.outputfile : fopen(fname.c_str(), "wb");
+    if (opt.verbose) {
+      cerr << "Writing bloom filter to " << fname << endl;
+    }
+
+    // First write metadata for bloom filter to the file,
+    // then the actual filter
+    if (fp == NULL || !bf.WriteBloomFilter(fp)) {
+      cerr << "Error writing data to file: " << fname << endl;
+    }
+    if (fp != NULL) {
+      fclose(fp);
+    }
+
+    if (opt.verbose) {
+      cerr << " done" << endl;
     }
   }
 
+  if (opt.ks.size() > 1) {
+    cache.remove();
+  }
 }
 
 // use:  FilterReads(argc, argv);
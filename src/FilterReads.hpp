@@ -1,9 +1,49 @@
 #ifndef BFG_FILTER_READS
 #define BFG_FILTER_READS
 
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "Common.hpp"
+
+class BlockedBloomFilter;
+class ReadCache;
+
+
+struct FilterReads_ProgramOptions {
+  bool verbose;
+  size_t threads, read_chunksize, k, nkmers, nkmers2;
+  vector<size_t> ks; // every k-mer size to filter for, k is the first
+  FILE *outputfile;
+  string output;
+  size_t bf, bf2;
+  uint32_t seed;
+  bool ref;
+  size_t streams; // input files read at once, 0 for one per thread
+  size_t min_qual, qual_scale; // bases below min_qual are masked, scale 0 is guessed
+  size_t norm_cov, norm_memory; // digital normalization coverage, 0 for none, and sketch MB
+  string norm_out; // fasta file for the reads kept by the normalization
+  bool dedup; // exact duplicate reads only go to the second filter and are not cached
+  size_t dedup_memory; // MB for the read fingerprints, 0 for the default
+  double max_fpr; // false positive rate that stops the run, 0 to only warn when a filter is overfull
+  size_t max_memory; // MB the filters and sketches must fit in, 0 for no limit
+  bool partitioned; // buffer the k-mers of each thread and insert them one part of the filters at a time
+  vector<string> files;
+  FilterReads_ProgramOptions() : verbose(false), threads(1), k(0), nkmers(0), nkmers2(0), \
+    outputfile(NULL), bf(4), bf2(8), seed(0), read_chunksize(10000), ref(false), streams(0), \
+    min_qual(0), qual_scale(0), norm_cov(0), norm_memory(0), \
+    dedup(false), dedup_memory(0), max_fpr(0), max_memory(0), partitioned(false) {}
+};
+
+
 /* Short description:
  *  - Go through reads and insert kmers into bloom filters
  * */
 void FilterReads(int argc, char **argv);
+void FilterReads_PrintSummary(const FilterReads_ProgramOptions& opt);
+bool FilterReads_CheckNormalization(const FilterReads_ProgramOptions& opt);
+bool FilterReads_PlanMemory(FilterReads_ProgramOptions& opt);
+void FilterReads_Filter(const FilterReads_ProgramOptions& opt, BlockedBloomFilter& bf, ReadCache *cache, bool replay = false);
 
 #endif // BFG_FILTER_READS
@@ -0,0 +1,331 @@
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "GzipReader.hpp"
+
+using namespace std;
+
+
+// batches read ahead of the consumer, per inflating thread
+static const size_t batches_per_thread = 2;
+
+
+// use:  x = le16(p); x = le32(p);
+// post: x is the little endian number at p
+static inline size_t le16(const unsigned char *p) {
+  return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t le32(const unsigned char *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+// use:  bsize = bgzfBlockSize(extra, xlen);
+// pre:  extra is the extra field of a gzip member header, xlen bytes long
+// post: bsize is the total block size minus 1 from the BC subfield, or 0 if there is none
+static size_t bgzfBlockSize(const unsigned char *extra, size_t xlen) {
+  size_t p = 0;
+  while (p + 4 <= xlen) {
+    size_t slen = le16(extra + p + 2);
+    if (extra[p] == 'B' && extra[p+1] == 'C' && slen == 2 && p + 6 <= xlen) {
+      return le16(extra + p + 4);
+    }
+    p += 4 + slen;
+  }
+  return 0;
+}
+
+
+// use:  b = GzipReader::detectBGZF(h, n);
+// pre:  h holds the first n bytes of a file
+// post: b is true if the file starts with a BGZF block
+bool GzipReader::detectBGZF(const unsigned char *h, size_t n) {
+  if (n < 18 || h[0] != 0x1f || h[1] != 0x8b || h[2] != 8 || (h[3] & 4) == 0) {
+    return false;
+  }
+  size_t xlen = std::min<size_t>(le16(h + 10), n - 12);
+  return bgzfBlockSize(h + 12, xlen) > 0;
+}
+
+
+// use:  b = inflateBlocks(zs, in, out);
+// pre:  zs has been set up for raw inflate, in holds whole BGZF blocks
+// post: the inflated blocks have been appended to out,
+//       b is false if a block is corrupt or its CRC does not match
+static bool inflateBlocks(z_stream& zs, const vector<char>& in, vector<char>& out) {
+  size_t p = 0;
+  while (p < in.size()) {
+    const unsigned char *b = (const unsigned char *) &in[p];
+    size_t xlen = le16(b + 10);
+    size_t bsize = bgzfBlockSize(b + 12, xlen) + 1;
+    uint32_t crc = le32(b + bsize - 8);
+    size_t isize = le32(b + bsize - 4);
+
+    size_t o = out.size();
+    out.resize(o + isize);
+    unsigned char dummy;
+    inflateReset(&zs);
+    zs.next_in = (Bytef *) (b + 12 + xlen);
+    zs.avail_in = bsize - 12 - xlen - 8;
+    zs.next_out = (isize > 0) ? (Bytef *) &out[o] : &dummy;
+    zs.avail_out = isize;
+    if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0) {
+      return false;
+    }
+    if (crc32(0L, (const Bytef *) (isize > 0 ? &out[o] : NULL), isize) != crc) {
+      return false;
+    }
+    p += bsize;
+  }
+  return true;
+}
+
+
+// use:  b = gr.open(fname);
+// post: if b then fname has been opened and the threads are reading it,
+//       data is read with gr.read
+bool GzipReader::open(const string& fname) {
+  close();
+
+  FILE *f = fopen(fname.c_str(), "rb");
+  if (f == NULL) {
+    return false;
+  }
+  // the file is read once from start to end, let the kernel read ahead further
+  posix_fadvise(fileno(f), 0, 0, POSIX_FADV_SEQUENTIAL);
+  unsigned char h[18];
+  size_t n = fread(h, 1, sizeof(h), f);
+  bgzf = detectBGZF(h, n);
+  if (bgzf) {
+    rewind(f);
+    fp = f;
+  } else {
+    fclose(f);
+    int fd = ::open(fname.c_str(), O_RDONLY);
+    if (fd >= 0) {
+      posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    gz = (fd >= 0) ? gzdopen(fd, "r") : NULL;
+    if (gz == NULL) {
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return false;
+    }
+  }
+
+  produced = consumed = 0;
+  eof = failed = stop = false;
+  out.clear();
+  outpos = 0;
+
+  threads.push_back(thread(&GzipReader::produce, this));
+  if (bgzf) {
+    for (size_t i = 0; i < nthreads; i++) {
+      threads.push_back(thread(&GzipReader::inflateBatches, this));
+    }
+  }
+  return true;
+}
+
+
+// use:  r = gr.readBatch(batch);
+// pre:  the file is BGZF, only called by the producing thread
+// post: batch holds the next batch_blocks blocks of the file or all that are left,
+//       r is 1 if batch is not empty, 0 at the end of the file
+//       and -1 if the file is truncated or not BGZF any more
+int GzipReader::readBatch(vector<char>& batch) {
+  batch.clear();
+  for (size_t i = 0; i < batch_blocks; i++) {
+    unsigned char h[12];
+    size_t n = fread(h, 1, sizeof(h), fp);
+    if (n == 0) {
+      break;
+    }
+    size_t xlen = (n == sizeof(h)) ? le16(h + 10) : 0;
+    size_t o = batch.size();
+    batch.resize(o + sizeof(h) + xlen);
+    memcpy(&batch[o], h, sizeof(h));
+    if (n < sizeof(h) || h[0] != 0x1f || h[1] != 0x8b || fread(&batch[o + sizeof(h)], 1, xlen, fp) != xlen) {
+      return -1;
+    }
+    size_t bsize = bgzfBlockSize((const unsigned char *) &batch[o + sizeof(h)], xlen) + 1;
+    if (bsize < sizeof(h) + xlen + 8 + 1) {
+      return -1;
+    }
+    size_t rest = bsize - sizeof(h) - xlen;
+    batch.resize(o + bsize);
+    if (fread(&batch[o + bsize - rest], 1, rest, fp) != rest) {
+      return -1;
+    }
+  }
+  return batch.empty() ? 0 : 1;
+}
+
+
+// use:  thread(&GzipReader::produce, this)
+// post: the whole file has been read, BGZF batches have been queued for the
+//       inflating threads, gzread chunks are handed out directly
+void GzipReader::produce() {
+  size_t max_batches = batches_per_thread * (bgzf ? nthreads : 1) + 1;
+  while (true) {
+    {
+      unique_lock<mutex> lock(m);
+      cv_space.wait(lock, [this, max_batches] { return stop || produced - consumed < max_batches; });
+      if (stop) {
+        break;
+      }
+    }
+
+    vector<char> batch;
+    int r;
+    if (bgzf) {
+      r = readBatch(batch);
+    } else {
+      batch.resize(chunk_size);
+      r = gzread(gz, &batch[0], chunk_size);
+      batch.resize(std::max(r, 0));
+      r = std::max(std::min(r, 1), -1);
+      if (r == 0) {
+        // a truncated file ends without an error from gzread, gzerror has it
+        int err;
+        gzerror(gz, &err);
+        if (err != Z_OK) {
+          r = -1;
+        }
+      }
+    }
+
+    unique_lock<mutex> lock(m);
+    if (r <= 0) {
+      failed = (r < 0);
+      break;
+    }
+    if (bgzf) {
+      work.push_back(make_pair(produced, vector<char>()));
+      work.back().second.swap(batch);
+      cv_work.notify_one();
+    } else {
+      done[produced].swap(batch);
+      cv_done.notify_one();
+    }
+    ++produced;
+  }
+
+  unique_lock<mutex> lock(m);
+  eof = true;
+  cv_work.notify_all();
+  cv_done.notify_all();
+}
+
+
+// use:  thread(&GzipReader::inflateBatches, this)
+// post: queued BGZF batches have been inflated until the file is done
+void GzipReader::inflateBatches() {
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  inflateInit2(&zs, -15); // raw deflate, the gzip wrapper is parsed here
+
+  while (true) {
+    pair<size_t, vector<char>> job;
+    {
+      unique_lock<mutex> lock(m);
+      cv_work.wait(lock, [this] { return stop || eof || !work.empty(); });
+      if (stop || work.empty()) {
+        break;
+      }
+      job.first = work.front().first;
+      job.second.swap(work.front().second);
+      work.pop_front();
+    }
+
+    vector<char> res;
+    res.reserve(job.second.size() * 4);
+    bool ok = inflateBlocks(zs, job.second, res);
+
+    unique_lock<mutex> lock(m);
+    if (!ok) {
+      failed = true;
+    }
+    done[job.first].swap(res);
+    cv_done.notify_all();
+  }
+
+  inflateEnd(&zs);
+}
+
+
+// use:  n = gr.read(buf, len);
+// pre:  gr has been opened
+// post: n > 0 bytes of the file have been copied to buf in order, n <= len,
+//       n == 0 at the end of the file or after an error, error() tells which
+int GzipReader::read(void *buf, unsigned len) {
+  char *dst = (char *) buf;
+  size_t n = 0;
+  while (n < len) {
+    if (outpos == out.size()) {
+      if (n > 0) {
+        break; // hand out what we have instead of waiting
+      }
+      unique_lock<mutex> lock(m);
+      cv_done.wait(lock, [this] { return failed || done.count(consumed) > 0 || (eof && consumed == produced); });
+      auto it = done.find(consumed);
+      if (it == done.end()) {
+        break;
+      }
+      out.swap(it->second);
+      done.erase(it);
+      outpos = 0;
+      ++consumed;
+      cv_space.notify_one();
+      continue;
+    }
+    size_t c = std::min<size_t>(len - n, out.size() - outpos);
+    memcpy(dst + n, &out[outpos], c);
+    n += c;
+    outpos += c;
+  }
+  return (int) n;
+}
+
+
+// use:  b = gr.error();
+// post: b is true if the file is corrupt or truncated, read has then
+//       returned 0 before the end of the file or will do so
+bool GzipReader::error() {
+  unique_lock<mutex> lock(m);
+  return failed;
+}
+
+
+// use:  gr.close();
+// post: the threads have stopped and the file has been closed
+void GzipReader::close() {
+  if (!threads.empty()) {
+    {
+      unique_lock<mutex> lock(m);
+      stop = true;
+    }
+    cv_work.notify_all();
+    cv_space.notify_all();
+    for (auto& t : threads) {
+      t.join();
+    }
+    threads.clear();
+  }
+  work.clear();
+  done.clear();
+  out.clear();
+  outpos = 0;
+  if (fp != NULL) {
+    fclose(fp);
+    fp = NULL;
+  }
+  if (gz != NULL) {
+    gzclose(gz);
+    gz = NULL;
+  }
+}
@@ -0,0 +1,67 @@
+#ifndef BFG_GZIP_READER_HPP
+#define BFG_GZIP_READER_HPP
+
+#include <cstdio>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+/* Short description:
+ *  - Reads a plain, gzip or BGZF compressed file for kseq, with gzread semantics
+ *  - BGZF files (blocked gzip, as written by bgzip and samtools) are read in
+ *    batches of blocks by one thread and the blocks are inflated with plain
+ *    zlib on a pool of threads, the output is handed out in file order
+ *  - Every other file is read with gzread on a separate read-ahead thread,
+ *    so decompression overlaps with parsing
+ *  - A corrupt or truncated file ends the data early, error tells it apart
+ *    from the end of the file
+ *  - read is not threadsafe, one thread consumes the data
+ * */
+class GzipReader {
+ public:
+  GzipReader(size_t threads = 1) : nthreads(threads > 0 ? threads : 1), fp(NULL), gz(NULL), bgzf(false),
+    produced(0), consumed(0), eof(false), failed(false), stop(false), outpos(0) {}
+  ~GzipReader() { close(); }
+
+  bool open(const std::string& fname);
+  int read(void *buf, unsigned len);
+  bool error();
+  void close();
+
+  bool isBGZF() const { return bgzf; }
+
+  static bool detectBGZF(const unsigned char *h, size_t n);
+
+  static const size_t batch_blocks = 64;  // BGZF blocks inflated by one thread in turn
+  static const size_t chunk_size = 1 << 20; // bytes per gzread on the read-ahead thread
+
+ private:
+  void produce();
+  void inflateBatches();
+  int readBatch(std::vector<char>& batch);
+
+  size_t nthreads;
+  FILE *fp;  // BGZF input
+  gzFile gz; // everything else
+  bool bgzf;
+
+  std::vector<std::thread> threads;
+  std::mutex m;
+  std::condition_variable cv_work, cv_done, cv_space;
+  std::deque<std::pair<size_t, std::vector<char>>> work; // compressed batches waiting for a thread
+  std::map<size_t, std::vector<char>> done; // output by batch number
+  size_t produced, consumed; // batches read from the file, batches handed out
+  bool eof, failed, stop;
+
+  std::vector<char> out; // the batch being handed out
+  size_t outpos;
+};
+
+#endif // BFG_GZIP_READER_HPP
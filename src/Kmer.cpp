@@ -1,4 +1,5 @@
 #include "Kmer.hpp"
+#include "TwoBitCodec.hpp"
 #include <bitset>
 #include <string>
 #include <iostream>
@@ -190,25 +191,24 @@ bool Kmer::operator<(const Kmer& o) const {
 // pre:  s[0],...,s[k-1] are all 'A','C','G' or 'T'
 // post: The DNA string in km is now equal to s
 void Kmer::set_kmer(const char *s)  {
-  size_t i,j,l;
-  memset(bytes,0,MAX_K/4);
-
-  for (i = 0; i < k; ++i) {
-    j = i % 32;
-    l = i/32;
-    assert(*s != '\0');
-
-    size_t x = ((*s) & 4) >> 1;
-    longs[l] |= ((x + ((x ^ (*s & 2)) >>1)) << (2*(31-j)));
-    /*
-    switch(*s) {
-      case 'A': break;
-      case 'C': longs[l] |= (0x01 << (2*j)); break;
-      case 'G': longs[l] |= (0x02 << (2*j)); break;
-      case 'T': longs[l] |= (0x03 << (2*j)); break;
-      }*/
-
-    s++;
+  uint64_t packed[MAX_K/32], invalid[MAX_K/64+1];
+  encodeBases(s, k, packed, invalid);
+  set_packed((const char *) packed, sizeof(packed), 0);
+}
+
+
+// use:  km.set_packed(packed, nbytes, offset);
+// pre:  packed has nbytes bytes of 2-bit encoded bases (see TwoBitCodec.hpp)
+//       and offset+k <= 4*nbytes
+// post: The DNA string in km is bases offset,...,offset+k-1 of packed
+void Kmer::set_packed(const char *packed, size_t nbytes, size_t offset) {
+  size_t nlongs = (k+31)/32;
+  for (size_t l = 0; l < MAX_K/32; l++) {
+    // the k-mer stores its first base in the top bits of each word
+    longs[l] = (l < nlongs) ? reverse_bases(load_bases(packed, nbytes, offset + 32*l)) : 0;
+  }
+  if (k % 32) {
+    longs[nlongs-1] &= ~0ULL << (64 - 2*(k%32)); // clear bases past k
   }
 }
 
@@ -367,8 +367,7 @@ Kmer Kmer::forwardBase(const char b) const {
     km.longs[i-1] |= (km.longs[i] & (3ULL<<62)) >> 62;
     km.longs[i]  = km.longs[i] << 2;
   }
-  uint64_t x = (b & 4) >>1;
-  km.longs[nlongs-1] |= (x + ((x ^ (b & 2)) >>1 )) << (2*(31-((k-1)%32)));
+  km.longs[nlongs-1] |= ((uint64_t) encodeBase(b)) << (2*(31-((k-1)%32)));
 
   return km;
   /********
@@ -403,8 +402,7 @@ Kmer Kmer::backwardBase(const char b) const {
     km.longs[nlongs-i] |= (km.longs[nlongs-i-1] & 3ULL) << 62;
     km.longs[nlongs-i-1] = km.longs[nlongs-i-1] >>2;
   }
-  uint64_t x = (b & 4) >> 1;
-  km.longs[0] |= (x + ((x ^ (b & 2)) >> 1)) << 62;
+  km.longs[0] |= ((uint64_t) encodeBase(b)) << 62;
 
   return km;
 
@@ -456,21 +454,12 @@ std::string Kmer::getBinary() const {
 // pre:  s has space for k+1 elements
 // post: s[0,...,k-1] is the DNA string for the Kmer km and s[k] = '\0'
 void Kmer::toString(char *s) const {
-  size_t i,j,l;
-
-  for (i = 0; i < k; i++) {
-    j = i % 32;
-    l = i / 32;
-
-    switch(((longs[l]) >> (2*(31-j)) )& 0x03 ) {
-    case 0x00: *s = 'A'; ++s; break;
-    case 0x01: *s = 'C'; ++s; break;
-    case 0x02: *s = 'G'; ++s; break;
-    case 0x03: *s = 'T'; ++s; break;
-    }
+  uint64_t packed[MAX_K/32];
+  for (size_t l = 0; l < MAX_K/32; l++) {
+    packed[l] = reverse_bases(longs[l]);
   }
-
-  *s = '\0';
+  decodeBases((const char *) packed, 0, k, s);
+  s[k] = '\0';
 }
 
 std::string Kmer::toString() const {
@@ -529,7 +518,7 @@ void Kmer::shiftBackward(int shift) {
 
 
 // use:  set_k(k);
-// pre:  this method has not been called before and 0 < k < MAX_K
+// pre:  0 < k < MAX_K, no Kmer made with an earlier k is used again
 // post: The Kmer size has been set to k
 void Kmer::set_k(unsigned int _k) {
   if(_k == k) {
@@ -537,7 +526,6 @@ void Kmer::set_k(unsigned int _k) {
   }
   assert(_k < MAX_K);
   assert(_k > 0);
-  assert(k_bytes == 0); // we can only call this once
   k = _k;
   k_bytes = (_k+3)/4;
   //  k_longs = (_k+15)/16;
@@ -58,6 +58,7 @@ class Kmer {
   }
 
   void set_kmer(const char *s);
+  void set_packed(const char *packed, size_t nbytes, size_t offset);
 
   uint64_t hash() const;
 
@@ -85,6 +86,9 @@ class Kmer {
   static unsigned int k;
 
  private:
+  friend class CompressedSequence; // builds k-mers directly from 2-bit words
+  friend class BloomFilterCache; // indexes its table with the packed words
+
   static unsigned int k_bytes;
   static unsigned int k_longs;
   static unsigned int k_modmask; // int?
@@ -4,6 +4,9 @@
 #include <utility>
 #include <string>
 #include <iterator>
+#include <memory>
+
+#include "LargeAlloc.hpp"
 
 /*#include <iostream> // debug
 	using namespace std;*/
@@ -104,7 +107,7 @@ struct KmerHashTable {
 
   void clear_table() {
     if (table != nullptr) {
-      delete[] table;
+      free_table(table, size_);
       table = nullptr;
     }
     size_ = 0;
@@ -131,8 +134,25 @@ struct KmerHashTable {
     size_ = rndup(sz);
     num_empty = 0;
     //cerr << "init table of size " << size_ << endl;
-    table = new value_type[size_];
-    std::fill(table, table+size_, empty_val);
+    table = alloc_table(size_);
+  }
+
+  // use:  t = alloc_table(n);
+  // post: t has n empty slots, large tables are on hugepages when the system has them
+  value_type *alloc_table(size_t n) {
+    value_type *t = (value_type *) allocLarge(n * sizeof(value_type));
+    std::uninitialized_fill(t, t+n, empty_val);
+    return t;
+  }
+
+  // use:  free_table(t, n);
+  // pre:  t = alloc_table(n)
+  // post: the slots of t have been destroyed and its memory given back
+  void free_table(value_type *t, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+      t[i].~value_type();
+    }
+    freeLarge(t, n * sizeof(value_type));
   }
 
   iterator find(const Kmer& key) {
@@ -222,6 +242,11 @@ struct KmerHashTable {
 
   }
 
+  // the memory used by the slots of the table in bytes, not counting what the values point to
+  size_t memory() const {
+    return size_ * sizeof(value_type);
+  }
+
   void reserve(size_t sz) {
 
     if (sz <= size_) {
@@ -236,14 +261,13 @@ struct KmerHashTable {
     pop = 0;
     num_empty = size_;
 
-    table = new value_type[size_];
-    std::fill(table, table+size_, empty_val);
+    table = alloc_table(size_);
     for (size_t i = 0; i < old_size_; i++) {
       if (old_table[i].first != empty_val.first && old_table[i].first != deleted.first) {
         insert(old_table[i]);
       }
     }
-    delete[] old_table;
+    free_table(old_table, old_size_);
     old_table = nullptr;
 
   }
@@ -1,24 +1,47 @@
+#include <cstring>
 #include <iterator>
 #include <utility>
 #include "Kmer.hpp"
 #include "KmerIterator.hpp"
+#include "TwoBitCodec.hpp"
 
 
 /* Note: That an iter is exhausted means that (iter._invalid == true) */
 
+// use:  iter = KmerIterator(s);
+// pre:  s is a 0-terminated string
+// post: *iter is the first valid pair of kmer and location in s
+//       OR iter is exhausted if s has no valid kmer
+KmerIterator::KmerIterator(const char *s) : s_(s), p_(), invalid_(false) {
+  read_.assign(s_, strlen(s_));
+  find_next(0);
+}
+
+
+// use:  iter = KmerIterator(s, len);
+// pre:  s has len characters, it need not be 0-terminated
+// post: *iter is the first valid pair of kmer and location in the first len characters of s
+//       OR iter is exhausted if they have no valid kmer
+KmerIterator::KmerIterator(const char *s, size_t len) : s_(s), p_(), invalid_(false) {
+  read_.assign(s_, len);
+  find_next(0);
+}
+
+
 // use:  ++iter;
 // pre:
 // post: *iter is now exhausted
 //       OR *iter is the next valid pair of kmer and location
 KmerIterator& KmerIterator::operator++() {
-  int pos_ = p_.second;
   if (!invalid_) {
-    if (s_[pos_+Kmer::k] == 0) {
+    size_t j = p_.second + Kmer::k; // the base that comes into view
+    if (j >= read_.size()) {
       invalid_ = true;
-      return *this;
+    } else if (read_.isBase(j)) {
+      p_.first = p_.first.forwardBase(s_[j]);
+      ++p_.second;
     } else {
-      find_next(pos_,pos_+Kmer::k-1,true);
-      return *this;
+      find_next(j+1);
     }
   }
   return *this;
@@ -77,39 +100,21 @@ void KmerIterator::raise(Kmer& km, Kmer& rep) {
   }
 }
 
-// use:  find_next(i,j, last_valid);
+// use:  find_next(i);
 // pre:
 // post: *iter is either invalid or is a pair of:
-//       1) the next valid kmer in the string that does not have any 'N'
+//       1) the first kmer starting at position >= i that does not have any 'N'
 //       2) the location of that kmer in the string
-void KmerIterator::find_next(size_t i, size_t j, bool last_valid) {
-  ++i;
-  ++j;
-
-  while (s_[j] != 0) {
-    char c = s_[j] & 0xDF; // mask lowercase bit
-    if (c == 'A' || c == 'C' || c == 'G' || c == 'T') {
-      if (last_valid) {
-        p_.first = p_.first.forwardBase(c);
-        break; // default case,
-      } else {
-        if (i + Kmer::k - 1 == j) {
-          p_.first = Kmer(s_+i);
-          last_valid = true;
-          break; // create k-mer from scratch
-        } else {
-          ++j;
-        }
-      }
-    } else {
-      ++j;
-      i = j;
-      last_valid = false;
+void KmerIterator::find_next(size_t i) {
+  size_t k = Kmer::k;
+  while (i + k <= read_.size()) {
+    size_t j = read_.nextInvalid(i);
+    if (j >= i + k) {
+      p_.first.set_packed(read_.bases(), read_.nbytes(), i);
+      p_.second = i;
+      return;
     }
+    i = j+1; // skip past the N
   }
-  if (i+Kmer::k-1 == j && s_[j] != 0) {
-    p_.second = i;
-  } else {
-    invalid_ = true;
-  }
+  invalid_ = true;
 }
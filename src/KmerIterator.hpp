@@ -3,6 +3,7 @@
 
 #include <iterator>
 #include "Kmer.hpp"
+#include "TwoBitCodec.hpp"
 
 
 /* Short description:
@@ -10,12 +11,16 @@
  *  - If the read contains any N, then the N is skipped and checked whether
  *    there is a kmer to the right of the N
  *  - iter->first gives the kmer, iter->second gives the position within the reads
+ *  - The read is 2-bit encoded once, along with a bitmask of the N positions,
+ *    k-mers are built by shifting instead of re-encoding characters
+ *  - With a length the read does not have to be 0-terminated, so it can
+ *    point into a larger buffer such as a mapped file
  * */
 class KmerIterator : public std::iterator<std::input_iterator_tag, std::pair<Kmer, int>, int> {
  public:
   KmerIterator() : s_(NULL), p_(), invalid_(true) {}
-  KmerIterator(const char *s) : s_(s), p_(), invalid_(false) { find_next(-1,-1,false);}
-  KmerIterator(const KmerIterator& o) : s_(o.s_), p_(o.p_), invalid_(o.invalid_) {}
+  KmerIterator(const char *s);
+  KmerIterator(const char *s, size_t len);
 
   KmerIterator& operator++();
   KmerIterator operator++(int);
@@ -28,11 +33,12 @@ class KmerIterator : public std::iterator<std::input_iterator_tag, std::pair<Kme
   std::pair<Kmer, int> *operator->();
 
  private:
-  void find_next(size_t i, size_t j, bool last_valid);
+  void find_next(size_t i);
 
   const char *s_;
   std::pair<Kmer, int> p_;
   bool invalid_;
+  PackedRead read_;
 };
 
 #endif // BFG_KMER_ITERATOR_HPP
@@ -0,0 +1,173 @@
+#ifndef BFG_LARGE_ALLOC_HPP
+#define BFG_LARGE_ALLOC_HPP
+
+#include <cstdlib>
+#include <cstdint>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+
+/* Short description:
+ *  - Memory for the large tables that are probed at random, the Bloom filters
+ *    and the hash tables, on hugepages one TLB entry covers 2MB or 1GB of them
+ *    instead of 4KB
+ *  - Allocations of at least 2MB first try explicit hugepages, 1GB ones when
+ *    the allocation is that large and rounding it up wastes less than 1/8 of
+ *    it, and then 2MB ones, then ask for transparent hugepages with madvise,
+ *    the explicit ones are only there when the system has reserved them
+ *  - Smaller allocations, and all of them on systems without mmap, are
+ *    64 byte aligned like before
+ *  - The bytes held of each kind are counted, largePageSummary reports them
+ * */
+enum LargePageKind { PAGES_1G, PAGES_2M, PAGES_TRANSPARENT, PAGES_SMALL, PAGES_KINDS };
+
+static const size_t huge_page_size = (size_t) 1 << 21;
+static const size_t giant_page_size = (size_t) 1 << 30;
+
+
+// use:  bytes = largePageBytes();
+// post: bytes[kind] is the number of bytes allocated with allocLarge and not freed of each kind
+inline std::atomic<size_t> *largePageBytes() {
+  static std::atomic<size_t> bytes[PAGES_KINDS];
+  return bytes;
+}
+
+
+// the mappings, their lengths and kinds, so freeLarge unmaps what was mapped
+struct LargeMapping {
+  size_t len;
+  LargePageKind kind;
+};
+
+inline std::map<void *, LargeMapping>& largeMappings(std::mutex *&lock) {
+  static std::map<void *, LargeMapping> mappings;
+  static std::mutex m;
+  lock = &m;
+  return mappings;
+}
+
+
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+// use:  p = mapLarge(bytes, len, kind);
+// post: p is a zeroed mapping of len >= bytes bytes on the best pages the system gave,
+//       kind says which, p is NULL if nothing could be mapped
+inline void *mapLarge(size_t bytes, size_t& len, LargePageKind& kind) {
+  void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+#ifdef MAP_HUGE_SHIFT
+  len = (bytes + giant_page_size - 1) & ~(giant_page_size - 1);
+  if (bytes >= giant_page_size && len - bytes < bytes / 8) {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (30 << MAP_HUGE_SHIFT), -1, 0);
+    if (p != MAP_FAILED) {
+      kind = PAGES_1G;
+      return p;
+    }
+  }
+#endif
+  len = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+  p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (p != MAP_FAILED) {
+    kind = PAGES_2M;
+    return p;
+  }
+#endif
+
+  // small pages, aligned to 2MB by mapping a little more and unmapping the ends,
+  // so the kernel can back them with transparent hugepages from the start
+  len = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+  p = mmap(NULL, len + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED) {
+    return NULL;
+  }
+  uintptr_t a = (uintptr_t) p, b = (a + huge_page_size - 1) & ~(uintptr_t) (huge_page_size - 1);
+  if (b > a) {
+    munmap(p, b - a);
+  }
+  munmap((void *) (b + len), a + huge_page_size - b);
+  p = (void *) b;
+  kind = PAGES_SMALL;
+#ifdef MADV_HUGEPAGE
+  if (madvise(p, len, MADV_HUGEPAGE) == 0) {
+    kind = PAGES_TRANSPARENT;
+  }
+#endif
+  return p;
+}
+#endif
+
+
+// use:  p = allocLarge(bytes);
+// post: p points to bytes of 64 byte aligned memory, on hugepages when they could
+//       be had and bytes is at least 2MB, throws std::bad_alloc when there is no memory
+inline void *allocLarge(size_t bytes) {
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+  if (bytes >= huge_page_size) {
+    size_t len;
+    LargePageKind kind;
+    void *p = mapLarge(bytes, len, kind);
+    if (p == NULL) {
+      throw std::bad_alloc();
+    }
+    std::mutex *lock;
+    std::map<void *, LargeMapping>& mappings = largeMappings(lock);
+    std::lock_guard<std::mutex> guard(*lock);
+    mappings[p] = LargeMapping{len, kind};
+    largePageBytes()[kind] += len;
+    return p;
+  }
+#endif
+  void *p;
+  if (posix_memalign(&p, 64, bytes) != 0) {
+    throw std::bad_alloc();
+  }
+  largePageBytes()[PAGES_SMALL] += bytes;
+  return p;
+}
+
+
+// use:  freeLarge(p, bytes);
+// pre:  p is NULL or p = allocLarge(bytes)
+// post: the memory of p has been given back
+inline void freeLarge(void *p, size_t bytes) {
+  if (p == NULL) {
+    return;
+  }
+#if defined(__linux__) && defined(MAP_ANONYMOUS)
+  if (bytes >= huge_page_size) {
+    std::mutex *lock;
+    std::map<void *, LargeMapping>& mappings = largeMappings(lock);
+    std::lock_guard<std::mutex> guard(*lock);
+    std::map<void *, LargeMapping>::iterator it = mappings.find(p);
+    largePageBytes()[it->second.kind] -= it->second.len;
+    munmap(p, it->second.len);
+    mappings.erase(it);
+    return;
+  }
+#endif
+  largePageBytes()[PAGES_SMALL] -= bytes;
+  free(p);
+}
+
+
+// use:  s = largePageSummary();
+// post: s says how many MB allocLarge holds on each kind of pages
+inline std::string largePageSummary() {
+  static const char *names[PAGES_KINDS] = {"1GB hugepages", "2MB hugepages", "transparent hugepages", "small pages"};
+  std::string s;
+  for (size_t i = 0; i < PAGES_KINDS; i++) {
+    size_t mb = largePageBytes()[i] >> 20;
+    if (mb > 0 || (i == PAGES_SMALL && s.empty())) {
+      s += (s.empty() ? "" : ", ") + std::to_string(mb) + "MB on " + names[i];
+    }
+  }
+  return s;
+}
+
+#endif // BFG_LARGE_ALLOC_HPP
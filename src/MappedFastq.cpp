@@ -0,0 +1,179 @@
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MappedFastq.hpp"
+
+using namespace std;
+
+
+// records checked by open to be on four lines, fastq files that wrap the
+// sequence and quality over more lines are left to kseq
+static const size_t checked_records = 1000;
+
+
+// use:  b = mf.open(fname);
+// post: if b then fname is an uncompressed fasta or fastq file and has been mapped,
+//       b is false for compressed files, fastq files whose first records are
+//       not on four lines and anything that could not be mapped
+bool MappedFastq::open(const string& fname) {
+  close();
+
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void *p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    return false;
+  }
+
+  const char *d = (const char *) p;
+  if (d[0] != '>' && d[0] != '@') {
+    munmap(p, st.st_size); // gzip or not a sequence file, kseq deals with it
+    return false;
+  }
+  madvise(p, st.st_size, MADV_SEQUENTIAL);
+  data_ = d;
+  size_ = st.st_size;
+  fastq_ = (d[0] == '@');
+  if (fastq_ && !fourLines(checked_records)) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+
+// use:  mf.close();
+// post: the file has been unmapped
+void MappedFastq::close() {
+  if (data_ != NULL) {
+    munmap((void *) data_, size_);
+    data_ = NULL;
+    size_ = 0;
+  }
+}
+
+
+// use:  e = lineEnd(p);
+// post: e is the position of the first newline at or after p, or the file size
+size_t MappedFastq::lineEnd(size_t p) const {
+  if (p >= size_) {
+    return size_;
+  }
+  const char *nl = (const char *) memchr(data_ + p, '\n', size_ - p);
+  return (nl == NULL) ? size_ : nl - data_;
+}
+
+
+// use:  q = nextLine(p);
+// post: q is the start of the line after the one p is on, or the file size
+size_t MappedFastq::nextLine(size_t p) const {
+  size_t e = lineEnd(p);
+  return (e < size_) ? e + 1 : size_;
+}
+
+
+// use:  n = lineLength(p);
+// pre:  p is the start of a line
+// post: n is the length of the line without the line break
+size_t MappedFastq::lineLength(size_t p) const {
+  size_t e = lineEnd(p);
+  if (e > p && data_[e-1] == '\r') {
+    --e;
+  }
+  return e - p;
+}
+
+
+// use:  b = fourLines(n);
+// pre:  the file is fastq
+// post: b is true if the first n records, or all if there are fewer, have a
+//       '+' line after the sequence line and a quality line of the same length
+bool MappedFastq::fourLines(size_t n) const {
+  size_t p = 0;
+  for (size_t i = 0; i < n && p < size_; i++) {
+    size_t s = nextLine(p), plus = nextLine(s), q = nextLine(plus);
+    if (data_[p] != '@' || plus >= size_ || data_[plus] != '+' || lineLength(s) != lineLength(q)) {
+      return false;
+    }
+    p = nextLine(q);
+  }
+  return true;
+}
+
+
+// use:  p = mf.sync(pos);
+// post: p is the start of the first record that starts at or after pos,
+//       or the file size if there is none
+size_t MappedFastq::sync(size_t pos) const {
+  if (pos == 0) {
+    return 0;
+  }
+  size_t p = (pos <= size_ && data_[pos-1] == '\n') ? pos : nextLine(pos);
+  while (p < size_) {
+    if (!fastq_) {
+      if (data_[p] == '>') {
+        return p;
+      }
+    } else if (data_[p] == '@') {
+      // a quality line can start with '@' too, but then the line after the
+      // next one is a sequence, in a record it is the '+' line
+      size_t s = nextLine(p), plus = nextLine(s), q = nextLine(plus);
+      if (plus < size_ && data_[plus] == '+' && lineLength(s) == lineLength(q)) {
+        return p;
+      }
+    }
+    p = nextLine(p);
+  }
+  return size_;
+}
+
+
+// use:  b = mf.next(pos, end, seq, len, buf);
+// pre:  pos is the start of a record, from sync or a previous call
+// post: if b the record at pos started before end, seq points to its len bases,
+//       in the file or in buf for wrapped fasta, and pos is the start of the next record,
+//       b is false if the record starts at or after end
+bool MappedFastq::next(size_t& pos, size_t end, const char *&seq, size_t& len, string& buf) const {
+  if (pos >= end || pos >= size_) {
+    return false;
+  }
+
+  size_t p = nextLine(pos); // skip the header
+  seq = data_ + p;
+  if (!fastq_ && (p >= size_ || data_[p] == '>')) {
+    // a fasta record without a sequence line, the next header is the next record
+    len = 0;
+    pos = p;
+    return true;
+  }
+  len = lineLength(p);
+  p = nextLine(p);
+  if (fastq_) {
+    pos = nextLine(nextLine(p)); // skip the '+' and quality lines
+    return true;
+  }
+
+  if (p < size_ && data_[p] != '>') {
+    // wrapped fasta, the lines are joined into buf
+    buf.assign(seq, len);
+    while (p < size_ && data_[p] != '>') {
+      buf.append(data_ + p, lineLength(p));
+      p = nextLine(p);
+    }
+    seq = buf.data();
+    len = buf.size();
+  }
+  pos = p;
+  return true;
+}
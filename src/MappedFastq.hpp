@@ -0,0 +1,45 @@
+#ifndef BFG_MAPPED_FASTQ_HPP
+#define BFG_MAPPED_FASTQ_HPP
+
+#include <cstddef>
+#include <string>
+
+
+/* Short description:
+ *  - Maps an uncompressed fasta or fastq file into memory and parses its
+ *    records in place, sequences are handed out as (pointer, length) views
+ *    into the file, use KmerIterator(seq, len) on them
+ *  - Only wrapped fasta sequences are copied, with the line breaks removed,
+ *    into a buffer owned by the caller
+ *  - The file can be split into byte ranges that are parsed by different
+ *    threads, sync finds the first record that starts in a range
+ *  - fastq records are expected on four lines, as written by sequencers,
+ *    open turns down files whose first records are not
+ *  - The parsing functions are const and threadsafe
+ * */
+class MappedFastq {
+ public:
+  MappedFastq() : data_(NULL), size_(0), fastq_(false) {}
+  ~MappedFastq() { close(); }
+
+  bool open(const std::string& fname);
+  void close();
+
+  size_t size() const { return size_; }
+  bool isFastq() const { return fastq_; }
+
+  size_t sync(size_t pos) const;
+  bool next(size_t& pos, size_t end, const char *&seq, size_t& len, std::string& buf) const;
+
+ private:
+  size_t lineEnd(size_t p) const;
+  size_t nextLine(size_t p) const;
+  size_t lineLength(size_t p) const;
+  bool fourLines(size_t n) const;
+
+  const char *data_;
+  size_t size_;
+  bool fastq_;
+};
+
+#endif // BFG_MAPPED_FASTQ_HPP
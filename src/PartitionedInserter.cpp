@@ -0,0 +1,113 @@
+#include "PartitionedInserter.hpp"
+
+using namespace std;
+
+
+// use:  ins = PartitionedInserter(bf, bf2);
+// pre:  bf2 is NULL if there is only the first filter
+// post: ins has empty buffers for every partition of bf and bf2
+PartitionedInserter::PartitionedInserter(BlockedBloomFilter& bf, BlockedBloomFilter *bf2) : bf(bf), bf2(bf2), ninserted(0) {
+  size_t parts = (bf.blocks() >> partition_shift) + 1;
+  first.resize(parts * buffer_size);
+  nfirst.assign(parts, 0);
+  if (bf2 != NULL) {
+    parts = (bf2->blocks() >> partition_shift) + 1;
+    second.resize(parts * buffer_size);
+    nsecond.assign(parts, 0);
+  }
+}
+
+
+// use:  ins.add(rep);
+// pre:  rep is the representative of a k-mer
+// post: rep will go into the first filter, or into the second one if the
+//       first already has it, when the buffer of its partition is applied
+void PartitionedInserter::add(const Kmer& rep) {
+  uint64_t h = bf.hash(rep);
+  size_t p = bf.block(h) >> partition_shift;
+  Pending& e = first[p * buffer_size + nfirst[p]];
+  e.h = h;
+  e.h2 = (bf2 != NULL) ? bf2->hash(rep) : 0;
+  if (++nfirst[p] == buffer_size) {
+    flushFirst(p);
+  }
+}
+
+
+// use:  ins.addTwice(rep);
+// pre:  rep is the representative of a k-mer from a second copy of a read, bf2 != NULL
+// post: rep will go straight into the second filter when the buffer of its partition is applied
+void PartitionedInserter::addTwice(const Kmer& rep) {
+  addSecond(bf2->hash(rep));
+}
+
+
+// use:  ins.addSecond(h2);
+// post: the item with hash h2 in the second filter has been buffered for it
+void PartitionedInserter::addSecond(uint64_t h2) {
+  size_t p = bf2->block(h2) >> partition_shift;
+  second[p * buffer_size + nsecond[p]] = h2;
+  if (++nsecond[p] == buffer_size) {
+    flushSecond(p);
+  }
+}
+
+
+// use:  ins.flush();
+// post: all the buffered k-mers have been applied to the filters, partition by partition
+void PartitionedInserter::flush() {
+  for (size_t p = 0; p < nfirst.size(); p++) {
+    flushFirst(p);
+  }
+  for (size_t p = 0; p < nsecond.size(); p++) {
+    flushSecond(p);
+  }
+}
+
+
+// use:  ins.flushFirst(p);
+// post: the buffer of partition p of the first filter has been applied in order and emptied,
+//       k-mers already in the first filter have been buffered for the second one
+void PartitionedInserter::flushFirst(size_t p) {
+  Pending *buf = &first[p * buffer_size];
+  size_t n = nfirst[p];
+  nfirst[p] = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i + 4 < n) {
+      bf.prefetch(buf[i + 4].h);
+    }
+    if (bf2 == NULL) {
+      if (!bf.containsHash(buf[i].h)) {
+        bf.insertHash(buf[i].h);
+        ++ninserted;
+      }
+      continue;
+    }
+    size_t r = bf.searchHash(buf[i].h);
+    if (r == 0) {
+      addSecond(buf[i].h2);
+    } else if (bf.insertHash(buf[i].h) == r) {
+      ++ninserted;
+    } else {
+      bf2->insertHash(buf[i].h2); // some of its bits were set, it may have been seen
+    }
+  }
+}
+
+
+// use:  ins.flushSecond(p);
+// post: the buffer of partition p of the second filter has been applied and emptied
+void PartitionedInserter::flushSecond(size_t p) {
+  uint64_t *buf = &second[p * buffer_size];
+  size_t n = nsecond[p];
+  nsecond[p] = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i + 4 < n) {
+      bf2->prefetch(buf[i + 4]);
+    }
+    if (!bf2->containsHash(buf[i])) {
+      bf2->insertHash(buf[i]);
+      ++ninserted;
+    }
+  }
+}
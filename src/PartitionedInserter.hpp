@@ -0,0 +1,56 @@
+#ifndef BFG_PARTITIONED_INSERTER_HPP
+#define BFG_PARTITIONED_INSERTER_HPP
+
+#include <vector>
+#include <stdint.h>
+
+#include "Kmer.hpp"
+#include "BlockedBloomFilter.hpp"
+
+
+/* Short description:
+ *  - Filters k-mers through the two BlockedBloomFilters like FilterReads does,
+ *    but buffers them first, for filters many times larger than the cache
+ *    where every k-mer is otherwise a miss in memory and in the TLB
+ *  - The blocks of a filter are split into partitions of 2MB, one hugepage,
+ *    and every partition has a small buffer of hashes. A full buffer is
+ *    applied in one go while its partition stays in the cache, flush applies
+ *    all of them in block order
+ *  - A k-mer always lands in the same partition and a buffer is applied in the
+ *    order it was filled, so the first filter sees the copies of a k-mer in
+ *    order and a k-mer found there goes to the buffers of the second filter.
+ *    With one thread the filters end up the same as without buffering
+ *  - Each thread has its own inserter, the filters are shared and updated
+ *    with atomic ors as insert does
+ * */
+class PartitionedInserter {
+ public:
+  PartitionedInserter(BlockedBloomFilter& bf, BlockedBloomFilter *bf2);
+
+  void add(const Kmer& rep);
+  void addTwice(const Kmer& rep);
+  void flush();
+
+  size_t inserted() const { return ninserted; }
+
+  static const size_t partition_shift = 15; // 2^15 blocks of 64 bytes in a partition
+  static const size_t buffer_size = 64; // hashes buffered for each partition
+
+ private:
+  struct Pending {
+    uint64_t h, h2; // the hashes for the first and second filter
+  };
+
+  void addSecond(uint64_t h2);
+  void flushFirst(size_t p);
+  void flushSecond(size_t p);
+
+  BlockedBloomFilter& bf;
+  BlockedBloomFilter *bf2; // NULL in reference mode, with only one filter
+  std::vector<Pending> first; // buffer_size entries for each partition of bf
+  std::vector<uint64_t> second; // and of bf2
+  std::vector<size_t> nfirst, nsecond; // entries in each buffer
+  size_t ninserted;
+};
+
+#endif // BFG_PARTITIONED_INSERTER_HPP
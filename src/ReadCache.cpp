@@ -0,0 +1,209 @@
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include "ReadCache.hpp"
+#include "TwoBitCodec.hpp"
+
+
+static const size_t file_buffer = 1 << 20;
+
+
+// use:  n = putVarint(fp, x);
+// post: x has been written to fp in 7-bit groups, low group first,
+//       n is the number of bytes written, a failed putc sets the error of fp
+static size_t putVarint(FILE *fp, size_t x) {
+  size_t n = 1;
+  while (x >= 0x80) {
+    putc((int) ((x & 0x7F) | 0x80), fp);
+    x >>= 7;
+    ++n;
+  }
+  putc((int) x, fp);
+  return n;
+}
+
+
+// use:  b = getVarint(fp, x, first);
+// post: if b then x is the next number written by putVarint, otherwise
+//       fp has no more data, first is true if not even a byte of x was read
+static bool getVarint(FILE *fp, size_t& x, bool& first) {
+  x = 0;
+  first = true;
+  for (size_t sh = 0; ; sh += 7) {
+    int c = getc(fp);
+    if (c == EOF) {
+      return false;
+    }
+    first = false;
+    x |= ((size_t) (c & 0x7F)) << sh;
+    if ((c & 0x80) == 0) {
+      return true;
+    }
+  }
+}
+
+
+// use:  j = nextBit(mask, i, len, set);
+// post: j is the first position >= i with bit j of mask equal to set, or len if there is none
+static size_t nextBit(const uint64_t *mask, size_t i, size_t len, bool set) {
+  while (i < len) {
+    uint64_t w = mask[i >> 6];
+    if (!set) {
+      w = ~w;
+    }
+    w >>= (i & 0x3F);
+    if (w != 0) {
+      size_t j = i + __builtin_ctzll(w);
+      return (j < len) ? j : len;
+    }
+    i = (i | 0x3F) + 1;
+  }
+  return len;
+}
+
+
+ReadCache::~ReadCache() {
+  remove();
+}
+
+
+// use:  b = rc.create(fname);
+// post: if b then fname has been created and rc is empty and ready for writing
+bool ReadCache::create(const std::string& fname_) {
+  remove();
+  fname = fname_;
+  fp = fopen(fname.c_str(), "wb");
+  if (fp == NULL) {
+    return false;
+  }
+  setvbuf(fp, NULL, _IOFBF, file_buffer);
+  writing = true;
+  failed = false;
+  nreads = nbases = nbytes = 0;
+  return true;
+}
+
+
+// use:  b = rc.write(seq);
+// pre:  rc has been created and not rewound
+// post: if b then seq has been appended to rc, otherwise writing failed
+//       and rc can not be rewound
+bool ReadCache::write(const std::string& seq) {
+  assert(fp != NULL && writing);
+  size_t len = seq.size(), nwords = (len + 31) / 32;
+  buf_.resize(nwords + (len + 63) / 64 + 1); // bases followed by the N bitmask
+  const uint64_t *invalid = &buf_[nwords];
+  encodeBases(seq.c_str(), len, &buf_[0], &buf_[nwords]);
+
+  runs_.clear();
+  for (size_t i = nextBit(invalid, 0, len, true); i < len; i = nextBit(invalid, i, len, true)) {
+    size_t j = nextBit(invalid, i, len, false);
+    runs_.push_back(i);
+    runs_.push_back(j - i);
+    i = j;
+  }
+
+  // length, number of runs, runs as (gap from the end of the last run, length), bases
+  size_t n = putVarint(fp, len) + putVarint(fp, runs_.size() / 2);
+  size_t end = 0;
+  for (size_t r = 0; r < runs_.size(); r += 2) {
+    n += putVarint(fp, runs_[r] - end) + putVarint(fp, runs_[r+1]);
+    end = runs_[r] + runs_[r+1];
+  }
+  size_t nb = (len + 3) / 4;
+  if ((nb > 0 && fwrite(&buf_[0], 1, nb, fp) != nb) || ferror(fp)) {
+    failed = true;
+    return false;
+  }
+
+  ++nreads;
+  nbases += len;
+  nbytes += n + nb;
+  return true;
+}
+
+
+// use:  b = rc.rewind();
+// pre:  rc has been created
+// post: if b then the next read_next returns the first sequence written to rc,
+//       b is false if a write or read of rc failed
+bool ReadCache::rewind() {
+  if (fp == NULL) {
+    return false;
+  }
+  if (writing) {
+    bool ok = !failed && !ferror(fp);
+    if (fclose(fp) != 0 || !ok) {
+      fp = NULL;
+      return false;
+    }
+    fp = fopen(fname.c_str(), "rb");
+    if (fp == NULL) {
+      return false;
+    }
+    setvbuf(fp, NULL, _IOFBF, file_buffer);
+    writing = false;
+    return true;
+  }
+  if (ferror(fp)) {
+    return false;
+  }
+  return fseek(fp, 0, SEEK_SET) == 0;
+}
+
+
+// use:  r = rc.read_next(seq);
+// pre:  rc has been rewound
+// post: r >= 0 is the length of the next sequence seq, r is -1 at the end of rc
+//       and -2 if the next record is cut short or could not be read
+int ReadCache::read_next(std::string& seq) {
+  assert(fp != NULL && !writing);
+  size_t len, nruns;
+  bool first;
+  if (!getVarint(fp, len, first)) {
+    return (first && !ferror(fp)) ? -1 : -2;
+  }
+  if (!getVarint(fp, nruns, first) || nruns > len) {
+    return -2;
+  }
+  runs_.resize(2*nruns);
+  size_t end = 0;
+  for (size_t r = 0; r < runs_.size(); r += 2) {
+    if (!getVarint(fp, runs_[r], first) || !getVarint(fp, runs_[r+1], first)) {
+      return -2;
+    }
+    runs_[r] += end;
+    end = runs_[r] + runs_[r+1];
+    if (end > len) {
+      return -2;
+    }
+  }
+
+  size_t nb = (len + 3) / 4;
+  buf_.resize(nb / 8 + 1);
+  if (nb > 0 && fread(&buf_[0], 1, nb, fp) != nb) {
+    return -2;
+  }
+  seq.resize(len);
+  if (len > 0) {
+    decodeBases((const char *) &buf_[0], 0, len, &seq[0]);
+  }
+  for (size_t r = 0; r < runs_.size(); r += 2) {
+    memset(&seq[runs_[r]], 'N', runs_[r+1]);
+  }
+  return (int) len;
+}
+
+
+// use:  rc.remove();
+// post: the file of rc has been closed and deleted
+void ReadCache::remove() {
+  if (fp != NULL) {
+    fclose(fp);
+    fp = NULL;
+  }
+  if (!fname.empty()) {
+    ::remove(fname.c_str());
+    fname.clear();
+  }
+}
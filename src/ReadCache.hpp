@@ -0,0 +1,46 @@
+#ifndef BFG_READ_CACHE_HPP
+#define BFG_READ_CACHE_HPP
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+/* Short description:
+ *  - Temporary file of read sequences at 2 bits per base, see TwoBitCodec.hpp
+ *  - Written once while the reads are filtered and read back for every
+ *    later pass, so the fasta/fastq files are only parsed once
+ *  - Names and qualities are dropped, runs of characters that are not
+ *    A,C,G,T are stored as (position, length) pairs and read back as 'N'
+ *  - Bases are read back in upper case
+ *  - A failed write makes rewind fail, a record cut short in the file is
+ *    an error from read_next and not the end of the cache
+ *  - Not threadsafe
+ * */
+class ReadCache {
+ public:
+  ReadCache() : fp(NULL), writing(false), failed(false), nreads(0), nbases(0), nbytes(0) {}
+  ~ReadCache();
+
+  bool create(const std::string& fname);
+  bool write(const std::string& seq);
+  bool rewind();
+  int read_next(std::string& seq);
+  void remove();
+
+  size_t reads() const { return nreads; }
+  size_t bases() const { return nbases; }
+  size_t bytes() const { return nbytes; }
+
+ private:
+  FILE *fp;
+  std::string fname;
+  bool writing;
+  bool failed; // a write failed, the file is not complete
+  size_t nreads, nbases, nbytes;
+  std::vector<uint64_t> buf_; // scratch space for encoding and decoding
+  std::vector<size_t> runs_;  // start and length of every N-run of a read
+};
+
+#endif // BFG_READ_CACHE_HPP
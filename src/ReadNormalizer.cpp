@@ -0,0 +1,93 @@
+#include <algorithm>
+
+#include "ReadNormalizer.hpp"
+#include "KmerIterator.hpp"
+#include "hash.hpp"
+
+using namespace std;
+
+
+// use:  norm = ReadNormalizer(bytes, coverage, seed);
+// pre:  coverage > 0
+// post: norm has a sketch of about bytes bytes, at least one block,
+//       and keeps reads until their k-mers have been seen coverage times
+ReadNormalizer::ReadNormalizer(size_t bytes, size_t coverage, uint32_t seed) : coverage(min<size_t>(coverage, 255)),
+  seed(seed), nreads(0), nkept(0) {
+  blocks = max<size_t>(bytes / 64, 1);
+  table.assign(8 * blocks, 0);
+}
+
+
+// use:  j = norm.slot(h, i);
+// pre:  h is the hash of a k-mer, i < counters
+// post: j is the byte of counter i of the k-mer with hash h in the table
+size_t ReadNormalizer::slot(uint64_t h, size_t i) const {
+  uint64_t block = h % blocks;
+  size_t pos = (h >> (40 + 6 * i)) & 63; // high bits, the low ones pick the block
+  return 64 * block + pos;
+}
+
+
+// use:  c = norm.count(rep);
+// post: c is an upper bound on how often rep has been counted in the kept reads
+size_t ReadNormalizer::count(const Kmer& rep) const {
+  uint64_t h; MurmurHash3_x64_64((const void *) &rep, sizeof(Kmer), seed, &h);
+  size_t c = 255;
+  for (size_t i = 0; i < counters; i++) {
+    c = min<size_t>(c, bytes()[slot(h, i)]);
+  }
+  return c;
+}
+
+
+// use:  b = norm.keep(seq);
+// post: b is false if the median count of the k-mers of seq had reached the coverage,
+//       otherwise the k-mers of seq have been counted and b is true,
+//       reads without k-mers are always kept
+bool ReadNormalizer::keep(const string& seq) {
+  ++nreads;
+  hashes.clear();
+  counts.clear();
+  KmerIterator iter(seq.c_str(), seq.size()), iterend;
+  for (; iter != iterend; ++iter) {
+    Kmer rep = iter->first.rep();
+    uint64_t h; MurmurHash3_x64_64((const void *) &rep, sizeof(Kmer), seed, &h);
+    hashes.push_back(h);
+    __builtin_prefetch(&table[8 * (h % blocks)], 1, 1);
+  }
+  if (hashes.empty()) {
+    ++nkept;
+    return true;
+  }
+
+  for (uint64_t h : hashes) {
+    size_t c = 255;
+    for (size_t i = 0; i < counters; i++) {
+      c = min<size_t>(c, bytes()[slot(h, i)]);
+    }
+    counts.push_back(c);
+  }
+  nth_element(counts.begin(), counts.begin() + counts.size() / 2, counts.end());
+  if (counts[counts.size() / 2] >= coverage) {
+    return false;
+  }
+
+  // conservative update, only the counters at the minimum grow
+  for (uint64_t h : hashes) {
+    uint8_t *c[counters];
+    uint8_t m = 255;
+    for (size_t i = 0; i < counters; i++) {
+      c[i] = bytes() + slot(h, i);
+      m = min(m, *c[i]);
+    }
+    if (m < 255) {
+      for (size_t i = 0; i < counters; i++) {
+        if (*c[i] == m) {
+          ++*c[i];
+        }
+      }
+    }
+  }
+  ++nkept;
+  return true;
+}
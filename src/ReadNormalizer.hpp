@@ -0,0 +1,47 @@
+#ifndef BFG_READ_NORMALIZER_HPP
+#define BFG_READ_NORMALIZER_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "Kmer.hpp"
+
+
+/* Short description:
+ *  - Digital normalization: a read is dropped when the median count of its
+ *    k-mers in the reads kept so far is already at the target coverage
+ *  - The counts are kept in a count-min sketch laid out like the
+ *    BlockedBloomFilter, every k-mer hashes to one 64 byte block and uses
+ *    4 of its 64 8-bit counters, so a lookup costs one cache miss
+ *  - Counters saturate at 255 and are updated conservatively, only the
+ *    smallest of the 4 are incremented
+ *  - keep is not threadsafe, the reads are normalized in the order they come
+ * */
+class ReadNormalizer {
+ public:
+  ReadNormalizer(size_t bytes, size_t coverage, uint32_t seed);
+
+  bool keep(const std::string& seq);
+
+  size_t count(const Kmer& rep) const;
+  size_t reads() const { return nreads; }
+  size_t kept() const { return nkept; }
+
+  static const size_t counters = 4; // counters per k-mer in its block
+
+ private:
+  size_t slot(uint64_t h, size_t i) const;
+  uint8_t *bytes() { return (uint8_t *) &table[0]; }
+  const uint8_t *bytes() const { return (const uint8_t *) &table[0]; }
+
+  std::vector<uint64_t> table; // 8 words per block
+  uint64_t blocks;
+  size_t coverage;
+  uint32_t seed;
+  size_t nreads, nkept;
+  std::vector<uint64_t> hashes; // scratch space for the k-mers of a read
+  std::vector<size_t> counts;
+};
+
+#endif // BFG_READ_NORMALIZER_HPP
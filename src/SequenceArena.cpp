@@ -0,0 +1,43 @@
+#include <cassert>
+#include <cstring>
+#include "SequenceArena.hpp"
+#include "TwoBitCodec.hpp"
+
+
+// use:  offset = arena.add(s);
+// pre:  s only has the bases 'A','C','G','T'
+// post: s is stored at offset, arena.get(offset, s.size()) == s
+size_t SequenceArena::add(const std::string& s) {
+  size_t len = s.size(), nwords = (len + 31) / 32;
+  buf_.resize(2*nwords + 1); // bases followed by the N bitmask
+  encodeBases(s.c_str(), len, &buf_[0], &buf_[nwords]);
+
+  size_t offset = data_.size();
+  size_t nbytes = (len + 3) / 4;
+  data_.resize(offset + nbytes);
+  if (nbytes > 0) {
+    memcpy(&data_[offset], &buf_[0], nbytes);
+  }
+  return offset;
+}
+
+
+// use:  s = arena.get(offset, len);
+// pre:  a string of length len was stored at offset
+// post: s is that string
+std::string SequenceArena::get(size_t offset, size_t len) const {
+  assert(offset + (len + 3) / 4 <= data_.size());
+  std::string s(len, 'A');
+  if (len > 0) {
+    decodeBases(&data_[offset], 0, len, &s[0]);
+  }
+  return s;
+}
+
+
+// use:  arena.clear();
+// post: all strings are gone and their memory has been released
+void SequenceArena::clear() {
+  std::vector<char>().swap(data_);
+  std::vector<uint64_t>().swap(buf_);
+}
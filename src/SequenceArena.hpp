@@ -0,0 +1,32 @@
+#ifndef BFG_SEQUENCE_ARENA_HPP
+#define BFG_SEQUENCE_ARENA_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+
+/* Short description:
+ *  - Append-only store of DNA strings at 2 bits per base, see TwoBitCodec.hpp
+ *  - add returns the offset of the string, the caller keeps the offset and
+ *    the length, so nothing else is stored per string
+ *  - Not threadsafe, strings are added by one thread at a time
+ * */
+class SequenceArena {
+ public:
+  SequenceArena() {}
+
+  size_t add(const std::string& s);
+  std::string get(size_t offset, size_t len) const;
+  void clear();
+  void reserve(size_t bytes) { data_.reserve(bytes); }
+
+  size_t size() const { return data_.size(); }
+  size_t memory() const { return sizeof(*this) + data_.capacity(); }
+
+ private:
+  std::vector<char> data_;
+  std::vector<uint64_t> buf_; // scratch space for encoding
+};
+
+#endif // BFG_SEQUENCE_ARENA_HPP
@@ -0,0 +1,187 @@
+#include <cstring>
+#include <algorithm>
+#include "Kmer.hpp"
+#include "SuperKmerIterator.hpp"
+
+
+/* Note: That an iter is exhausted means that (iter.invalid_ == true) */
+
+
+// the MurmurHash3 finalizer, a bijection so equal hashes mean equal m-mers
+static inline uint64_t mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+
+// use:  km = sk.getKmer(i);
+// pre:  0 <= i < sk.count
+// post: km is the k-mer at position sk.pos+i of the read
+Kmer SuperKmer::getKmer(size_t i) const {
+  Kmer km;
+  km.set_packed(packed, nbytes, pos + i);
+  return km;
+}
+
+
+// use:  iter = SuperKmerIterator(s, m);
+// pre:  s is a 0-terminated string, 0 < m, Kmer::k has been set
+// post: *iter is the first super k-mer of s with minimizers of length min(m, k, 32)
+//       OR iter is exhausted if s has no valid kmer
+SuperKmerIterator::SuperKmerIterator(const char *s, size_t m) : s_(s), invalid_(false),
+  m_(std::min<size_t>(std::min<size_t>(m, Kmer::k), 32)), next_(0), primed_(false),
+  nbases_(0), fw_(0), rc_(0), head_(0), size_(0) {
+  // a window has k-m+1 m-mers and one more is pushed before the oldest is popped
+  size_t cap = 1;
+  while (cap < Kmer::k - m_ + 2) {
+    cap <<= 1;
+  }
+  queue_.resize(cap);
+  read_.assign(s_, strlen(s_));
+  find_next();
+}
+
+
+// use:  reset();
+// post: the queue and the rolling m-mers are empty
+void SuperKmerIterator::reset() {
+  head_ = size_ = 0;
+  nbases_ = 0;
+  fw_ = rc_ = 0;
+}
+
+
+// use:  roll(j, start);
+// pre:  base j is valid and follows the last base rolled in, if any
+// post: the m-mer ending at j is in the queue (if there are m bases since the last reset)
+//       and the queue has no m-mers starting before start
+void SuperKmerIterator::roll(size_t j, size_t start) {
+  uint64_t c = read_.at(j);
+  uint64_t mmask = (m_ == 32) ? ~0ULL : ((1ULL << (2*m_)) - 1);
+  fw_ = ((fw_ << 2) | c) & mmask;
+  rc_ = (rc_ >> 2) | ((3 - c) << (2*(m_-1)));
+
+  if (++nbases_ >= m_) {
+    Entry e;
+    e.value = std::min(fw_, rc_);
+    e.hash = mix(e.value);
+    e.pos = j + 1 - m_;
+    // drop larger m-mers from the back, equal ones stay so the leftmost wins
+    size_t qmask = queue_.size() - 1;
+    while (size_ > 0 && queue_[(head_ + size_ - 1) & qmask].hash > e.hash) {
+      --size_;
+    }
+    queue_[(head_ + size_) & qmask] = e;
+    ++size_;
+  }
+
+  while (size_ > 0 && queue_[head_].pos < start) {
+    head_ = (head_ + 1) & (queue_.size() - 1);
+    --size_;
+  }
+}
+
+
+// use:  find_next();
+// pre:  next_ is the first k-mer that has not been returned
+// post: sk_ is the next super k-mer OR iter is exhausted
+void SuperKmerIterator::find_next() {
+  size_t k = Kmer::k, len = read_.size();
+
+  if (!primed_) {
+    // find the next k-mer without N's and roll in its bases
+    size_t i = next_;
+    while (true) {
+      if (i + k > len) {
+        invalid_ = true;
+        return;
+      }
+      size_t j = read_.nextInvalid(i);
+      if (j >= i + k) {
+        break;
+      }
+      i = j + 1;
+    }
+    reset();
+    for (size_t j = i; j < i + k; j++) {
+      roll(j, i);
+    }
+    next_ = i;
+  }
+
+  sk_.pos = next_;
+  sk_.count = 1;
+  sk_.minimizer = queue_[head_].value;
+
+  // extend while the next k-mer has the same minimizer, a new minimizer
+  // leaves the queue primed for the k-mer where the next run starts
+  primed_ = false;
+  for (size_t j = next_ + k; j < len && read_.isBase(j); j++) {
+    roll(j, j + 1 - k);
+    if (queue_[head_].value != sk_.minimizer) {
+      primed_ = true;
+      break;
+    }
+    ++sk_.count;
+  }
+  next_ = sk_.pos + sk_.count;
+}
+
+
+// use:  ++iter;
+// pre:
+// post: *iter is now exhausted
+//       OR *iter is the next super k-mer
+SuperKmerIterator& SuperKmerIterator::operator++() {
+  if (!invalid_) {
+    find_next();
+  }
+  return *this;
+}
+
+
+// use:  iter++;
+// pre:
+// post: iter has been incremented by one
+SuperKmerIterator SuperKmerIterator::operator++(int) {
+  SuperKmerIterator tmp(*this);
+  operator++();
+  return tmp;
+}
+
+
+// use:  val = (a == b);
+// pre:
+// post: (val == true) if a and b are both exhausted
+//       OR a and b are at the same super k-mer of the same string.
+//       (val == false) otherwise.
+bool SuperKmerIterator::operator==(const SuperKmerIterator& o) {
+  if (invalid_  || o.invalid_) {
+    return invalid_ && o.invalid_;
+  } else {
+    return (s_ == o.s_) && (sk_.pos == o.sk_.pos);
+  }
+}
+
+
+// use:  sk = *iter;
+// pre:  iter is not exhausted
+// post: sk is the current super k-mer
+SuperKmer& SuperKmerIterator::operator*() {
+  // the packed read lives in this iterator, which may have been copied
+  sk_.packed = read_.bases();
+  sk_.nbytes = read_.nbytes();
+  return sk_;
+}
+
+
+// use:  m = iter->minimizer;
+// pre:  iter is not exhausted
+// post: m is (*iter).minimizer
+SuperKmer *SuperKmerIterator::operator->() {
+  return &(operator*());
+}
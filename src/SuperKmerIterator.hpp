@@ -0,0 +1,76 @@
+#ifndef BFG_SUPERKMER_ITERATOR_HPP
+#define BFG_SUPERKMER_ITERATOR_HPP
+
+#include <iterator>
+#include <vector>
+#include "Kmer.hpp"
+#include "TwoBitCodec.hpp"
+
+
+/* Short description:
+ *  - A super k-mer is a maximal run of consecutive k-mers in a read
+ *    that share the same minimizer
+ *  - minimizer is the canonical m-mer (2 bits per base, first base in the
+ *    highest bits) with the smallest hash value among the k-m+1 m-mers of a k-mer
+ *  - pos is the position of the first k-mer in the read, count the number of k-mers,
+ *    the bases pos,...,pos+count+k-2 are in packed, see TwoBitCodec.hpp for the layout
+ * */
+struct SuperKmer {
+  uint64_t minimizer;
+  size_t pos;
+  size_t count;
+  const char *packed;
+  size_t nbytes;
+
+  Kmer getKmer(size_t i) const; // the i-th k-mer of the run, 0 <= i < count
+};
+
+
+/* Short description:
+ *  - Iterate through the super k-mers of a read, skipping k-mers with N's
+ *  - The minimizers are found with a monotone queue so every base is
+ *    pushed and popped at most once
+ *  - The read is 2-bit encoded once and iter->packed points into the iterator,
+ *    it is valid until the iterator is incremented or destroyed
+ * */
+class SuperKmerIterator : public std::iterator<std::input_iterator_tag, SuperKmer, int> {
+ public:
+  SuperKmerIterator() : s_(NULL), invalid_(true), m_(0) {}
+  SuperKmerIterator(const char *s, size_t m = default_m);
+
+  SuperKmerIterator& operator++();
+  SuperKmerIterator operator++(int);
+
+  bool operator==(const SuperKmerIterator& o);
+  bool operator!=(const SuperKmerIterator& o) { return !this->operator==(o);}
+
+  SuperKmer& operator*();
+  SuperKmer *operator->();
+
+  static const size_t default_m = 15;
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    uint64_t value;
+    size_t pos;
+  };
+
+  void find_next();
+  void reset();
+  void roll(size_t j, size_t start);
+
+  const char *s_;
+  bool invalid_;
+  size_t m_;
+  size_t next_;     // the first k-mer not yet in a super k-mer
+  bool primed_;     // queue holds the m-mers of the k-mer at next_
+  size_t nbases_;   // bases rolled in since the last N
+  uint64_t fw_, rc_;
+  std::vector<Entry> queue_; // ring buffer, size is a power of 2
+  size_t head_, size_;
+  SuperKmer sk_;
+  PackedRead read_;
+};
+
+#endif // BFG_SUPERKMER_ITERATOR_HPP
@@ -0,0 +1,333 @@
+#include <cstring>
+#include <stdint.h>
+
+#include "Common.hpp"
+#include "TwoBitCodec.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BFG_CODEC_X86 1
+#include <immintrin.h>
+#endif
+
+
+// codes['A'] == codes['a'] == 0, ... , codes['T'] == codes['t'] == 3
+// every other character is 4
+static const uint8_t codes[256] = {
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 0, 4, 1, 4, 4, 4, 2, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+  4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4
+};
+
+
+// four ASCII bases for every byte of packed data
+struct DecodeTable {
+  uint32_t t[256];
+  DecodeTable() {
+    for (size_t b = 0; b < 256; b++) {
+      char s[4];
+      for (size_t j = 0; j < 4; j++) {
+        s[j] = alpha[(b >> (2*j)) & 0x03];
+      }
+      memcpy(&t[b], s, 4);
+    }
+  }
+};
+
+static const DecodeTable decode_table;
+
+
+// use:  encode32(s, w, inv);
+// pre:  s has 32 readable characters
+// post: w holds the 2-bit codes of s[0,...,31], bit j of inv is set iff s[j] is not a base
+static inline void encode32_scalar(const char *s, uint64_t& w, uint32_t& inv) {
+  w = 0;
+  inv = 0;
+  for (size_t j = 0; j < 32; j++) {
+    uint8_t c = codes[(uint8_t) s[j]];
+    if (c > 3) {
+      inv |= 1U << j;
+      c = 0;
+    }
+    w |= ((uint64_t) c) << (2*j);
+  }
+}
+
+
+#ifdef BFG_CODEC_X86
+
+__attribute__((target("sse4.1")))
+static inline void encode16_sse41(const char *s, uint32_t& w, uint32_t& inv) {
+  __m128i c = _mm_loadu_si128((const __m128i *) s);
+  __m128i up = _mm_and_si128(c, _mm_set1_epi8((char) 0xDF)); // mask lowercase bit
+  __m128i v = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(up, _mm_set1_epi8('A')), _mm_cmpeq_epi8(up, _mm_set1_epi8('C'))),
+                _mm_or_si128(_mm_cmpeq_epi8(up, _mm_set1_epi8('G')), _mm_cmpeq_epi8(up, _mm_set1_epi8('T'))));
+  // the low nibble tells the bases apart, A = 1, C = 3, T = 4, G = 7
+  const __m128i lut = _mm_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i code = _mm_and_si128(_mm_shuffle_epi8(lut, _mm_and_si128(c, _mm_set1_epi8(0x0F))), v);
+  // pack 2 bit codes, 16 bit lanes get c0 + 4*c1, 32 bit lanes get c01 + 16*c23
+  __m128i p = _mm_maddubs_epi16(code, _mm_set1_epi16(0x0401));
+  p = _mm_madd_epi16(p, _mm_set1_epi32(0x00100001));
+  p = _mm_shuffle_epi8(p, _mm_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+  w = (uint32_t) _mm_cvtsi128_si32(p);
+  inv = ~((uint32_t) _mm_movemask_epi8(v)) & 0xFFFF;
+}
+
+__attribute__((target("sse4.1")))
+static inline void encode32_sse41(const char *s, uint64_t& w, uint32_t& inv) {
+  uint32_t w0, w1, i0, i1;
+  encode16_sse41(s, w0, i0);
+  encode16_sse41(s + 16, w1, i1);
+  w = w0 | (((uint64_t) w1) << 32);
+  inv = i0 | (i1 << 16);
+}
+
+__attribute__((target("avx2")))
+static inline void encode32_avx2(const char *s, uint64_t& w, uint32_t& inv) {
+  __m256i c = _mm256_loadu_si256((const __m256i *) s);
+  __m256i up = _mm256_and_si256(c, _mm256_set1_epi8((char) 0xDF));
+  __m256i v = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(up, _mm256_set1_epi8('A')), _mm256_cmpeq_epi8(up, _mm256_set1_epi8('C'))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(up, _mm256_set1_epi8('G')), _mm256_cmpeq_epi8(up, _mm256_set1_epi8('T'))));
+  const __m256i lut = _mm256_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0,
+                                       0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m256i code = _mm256_and_si256(_mm256_shuffle_epi8(lut, _mm256_and_si256(c, _mm256_set1_epi8(0x0F))), v);
+  __m256i p = _mm256_maddubs_epi16(code, _mm256_set1_epi16(0x0401));
+  p = _mm256_madd_epi16(p, _mm256_set1_epi32(0x00100001));
+  p = _mm256_shuffle_epi8(p, _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                              0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+  w = ((uint64_t) (uint32_t) _mm256_extract_epi32(p, 0)) | (((uint64_t) (uint32_t) _mm256_extract_epi32(p, 4)) << 32);
+  inv = ~((uint32_t) _mm256_movemask_epi8(v));
+}
+
+
+// use:  decode16(packed, s);
+// pre:  packed has 4 bytes, s has space for 16 characters
+// post: s[0,...,15] are the bases in packed
+__attribute__((target("sse4.1")))
+static inline void decode16_sse41(const char *packed, char *s) {
+  int32_t x;
+  memcpy(&x, packed, 4);
+  // every byte four times, keep base j of the byte in the j-th copy
+  __m128i t = _mm_shuffle_epi8(_mm_cvtsi32_si128(x), _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3));
+  t = _mm_and_si128(t, _mm_set1_epi32(0xC0300C03));
+  // bring bases 2 and 3 down to the low nibble, now every byte is c or 4*c
+  t = _mm_or_si128(_mm_and_si128(t, _mm_set1_epi32(0x0000FFFF)),
+                   _mm_and_si128(_mm_srli_epi16(t, 4), _mm_set1_epi32(0x0F0F0000)));
+  const __m128i lut = _mm_setr_epi8('A', 'C', 'G', 'T', 'C', 0, 0, 0, 'G', 0, 0, 0, 'T', 0, 0, 0);
+  _mm_storeu_si128((__m128i *) s, _mm_shuffle_epi8(lut, t));
+}
+
+__attribute__((target("avx2")))
+static inline void decode32_avx2(const char *packed, char *s) {
+  int64_t x;
+  memcpy(&x, packed, 8);
+  __m256i t = _mm256_shuffle_epi8(_mm256_set1_epi64x(x),
+                                  _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                                   4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7));
+  t = _mm256_and_si256(t, _mm256_set1_epi32(0xC0300C03));
+  t = _mm256_or_si256(_mm256_and_si256(t, _mm256_set1_epi32(0x0000FFFF)),
+                      _mm256_and_si256(_mm256_srli_epi16(t, 4), _mm256_set1_epi32(0x0F0F0000)));
+  const __m256i lut = _mm256_setr_epi8('A', 'C', 'G', 'T', 'C', 0, 0, 0, 'G', 0, 0, 0, 'T', 0, 0, 0,
+                                       'A', 'C', 'G', 'T', 'C', 0, 0, 0, 'G', 0, 0, 0, 'T', 0, 0, 0);
+  _mm256_storeu_si256((__m256i *) s, _mm256_shuffle_epi8(lut, t));
+}
+
+#endif // BFG_CODEC_X86
+
+
+// use:  encode_blocks<encode32>(s, len, packed, invalid);
+// post: see encodeBases, whole blocks of 32 characters are handed to encode32
+//       and the tail is padded with zeros (which are invalid) first
+template<void (*encode32)(const char *, uint64_t&, uint32_t&)>
+static inline void encode_blocks(const char *s, size_t len, uint64_t *packed, uint64_t *invalid) {
+  size_t nblocks = (len + 31) / 32;
+  if (nblocks > 0) {
+    memset(invalid, 0, ((len + 63) / 64) * sizeof(uint64_t));
+  }
+  for (size_t b = 0; b < nblocks; b++) {
+    uint64_t w;
+    uint32_t inv;
+    size_t n = len - 32*b;
+    if (n >= 32) {
+      encode32(s + 32*b, w, inv);
+    } else {
+      char buf[32];
+      memset(buf, 0, 32);
+      memcpy(buf, s + 32*b, n);
+      encode32(buf, w, inv);
+      w &= (1ULL << (2*n)) - 1;
+      inv &= (1U << n) - 1;
+    }
+    packed[b] = w;
+    invalid[b >> 1] |= ((uint64_t) inv) << (32*(b & 1));
+  }
+}
+
+#ifdef BFG_CODEC_X86
+__attribute__((target("sse4.1")))
+static void encode_sse41(const char *s, size_t len, uint64_t *packed, uint64_t *invalid) {
+  encode_blocks<encode32_sse41>(s, len, packed, invalid);
+}
+
+__attribute__((target("avx2")))
+static void encode_avx2(const char *s, size_t len, uint64_t *packed, uint64_t *invalid) {
+  encode_blocks<encode32_avx2>(s, len, packed, invalid);
+}
+#endif
+
+
+static CodecLevel detectCodecLevel() {
+#ifdef BFG_CODEC_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return CODEC_AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.1")) {
+    return CODEC_SSE41;
+  }
+#endif
+  return CODEC_SCALAR;
+}
+
+static const CodecLevel best_level = detectCodecLevel();
+static CodecLevel level = best_level;
+
+
+// use:  encodeBases(s, len, packed, invalid);
+// pre:  s has len characters, packed has space for (len+31)/32 words
+//       and invalid has space for (len+63)/64 words
+// post: packed holds the 2-bit codes of s and bit i of invalid is set iff
+//       s[i] is not 'A','C','G' or 'T', those positions are encoded as 'A'.
+//       Bits past len are 0 in both arrays.
+void encodeBases(const char *s, size_t len, uint64_t *packed, uint64_t *invalid) {
+  switch (level) {
+#ifdef BFG_CODEC_X86
+  case CODEC_AVX2:
+    encode_avx2(s, len, packed, invalid);
+    break;
+  case CODEC_SSE41:
+    encode_sse41(s, len, packed, invalid);
+    break;
+#endif
+  default:
+    encode_blocks<encode32_scalar>(s, len, packed, invalid);
+    break;
+  }
+}
+
+
+// use:  decodeBases(packed, offset, len, s);
+// pre:  packed holds at least offset+len bases, s has space for len characters
+// post: s[0,...,len-1] are the bases offset,...,offset+len-1 of packed,
+//       s is not 0-terminated
+void decodeBases(const char *packed, size_t offset, size_t len, char *s) {
+  // single bases until we are at a byte boundary
+  for (; len > 0 && (offset & 0x03) != 0; --len, ++offset) {
+    *s++ = alpha[(packed[offset >> 2] >> (2*(offset & 0x03))) & 0x03];
+  }
+
+  const char *p = packed + (offset >> 2);
+  size_t nbytes = len >> 2;
+  size_t b = 0;
+#ifdef BFG_CODEC_X86
+  if (level == CODEC_AVX2) {
+    for (; b + 8 <= nbytes; b += 8, s += 32) {
+      decode32_avx2(p + b, s);
+    }
+  } else if (level == CODEC_SSE41) {
+    for (; b + 4 <= nbytes; b += 4, s += 16) {
+      decode16_sse41(p + b, s);
+    }
+  }
+#endif
+  for (; b < nbytes; b++, s += 4) {
+    memcpy(s, &decode_table.t[(uint8_t) p[b]], 4);
+  }
+
+  // the last few bases
+  offset += 4*nbytes;
+  for (len &= 0x03; len > 0; --len, ++offset) {
+    *s++ = alpha[(packed[offset >> 2] >> (2*(offset & 0x03))) & 0x03];
+  }
+}
+
+
+// use:  pr.assign(s, len);
+// pre:  s has len characters
+// post: pr holds the 2-bit encoding of s and the positions of non-bases
+void PackedRead::assign(const char *s, size_t len) {
+  len_ = len;
+  size_t n = nwords() + (len_+63)/64;
+  uint64_t *w = local_;
+  if (n > 16) {
+    heap_.resize(n);
+    w = &heap_[0];
+  } else {
+    heap_.clear();
+  }
+  encodeBases(s, len_, w, w + nwords());
+}
+
+
+// use:  j = pr.nextInvalid(i);
+// post: j is the first position >= i that is not a base
+//       or pr.size() if there is none
+size_t PackedRead::nextInvalid(size_t i) const {
+  if (i >= len_) {
+    return len_;
+  }
+  const uint64_t *m = mask();
+  size_t w = i >> 6, nmask = (len_+63)/64;
+  uint64_t bits = m[w] & (~0ULL << (i & 0x3F));
+  while (bits == 0) {
+    if (++w == nmask) {
+      return len_;
+    }
+    bits = m[w];
+  }
+  return 64*w + __builtin_ctzll(bits);
+}
+
+
+// use:  l = codecLevel();
+// post: l is the instruction set used for encoding and decoding
+CodecLevel codecLevel() {
+  return level;
+}
+
+
+// use:  s = codecName();
+// post: s is the name of the instruction set in use
+const char *codecName() {
+  switch (level) {
+  case CODEC_AVX2: return "avx2";
+  case CODEC_SSE41: return "sse4.1";
+  default: return "scalar";
+  }
+}
+
+
+// use:  b = setCodecLevel(l);
+// post: if the CPU supports l then it is used from now on and b is true,
+//       otherwise nothing changes and b is false
+bool setCodecLevel(CodecLevel l) {
+  if (l > best_level) {
+    return false;
+  }
+  level = l;
+  return true;
+}
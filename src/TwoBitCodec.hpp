@@ -0,0 +1,116 @@
+#ifndef BFG_TWOBITCODEC_HPP
+#define BFG_TWOBITCODEC_HPP
+
+#include <cstring>
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+
+/* Short description:
+ *  - Encode DNA strings into 2 bits per base and decode them back to ASCII
+ *  - Bases are packed in the same layout as CompressedSequence, base i is
+ *    stored in bits 2*(i%4) of byte i/4, i.e. bits 2*(i%32) of 64-bit word i/32
+ *  - Encoding also marks every position that is not 'A','C','G' or 'T'
+ *    (either case) in a bitmask, bit i%64 of word i/64
+ *  - Uses AVX2 or SSE4.1 shuffles when the CPU has them, with a scalar fallback
+ * */
+
+enum CodecLevel { CODEC_SCALAR = 0, CODEC_SSE41 = 1, CODEC_AVX2 = 2 };
+
+void encodeBases(const char *s, size_t len, uint64_t *packed, uint64_t *invalid);
+void decodeBases(const char *packed, size_t offset, size_t len, char *s);
+
+CodecLevel codecLevel();
+const char *codecName();
+bool setCodecLevel(CodecLevel level); // for testing, false if not supported
+
+
+/* Short description:
+ *  - A read encoded once with encodeBases, together with its N bitmask
+ *  - Reads up to 320 bp are stored inside the object, longer ones on the heap
+ * */
+class PackedRead {
+ public:
+  PackedRead() : len_(0) {}
+  void assign(const char *s, size_t len);
+
+  size_t size() const { return len_; }
+  const char *bases() const { return (const char *) words(); }
+  size_t nbytes() const { return 8*nwords(); }
+  uint8_t at(size_t i) const { return (words()[i >> 5] >> (2*(i & 0x1F))) & 0x03; }
+  bool isBase(size_t i) const { return ((mask()[i >> 6] >> (i & 0x3F)) & 1) == 0; }
+  size_t nextInvalid(size_t i) const;
+
+ private:
+  size_t nwords() const { return (len_+31)/32; }
+  const uint64_t *words() const { return heap_.empty() ? local_ : &heap_[0]; }
+  const uint64_t *mask() const { return words() + nwords(); }
+
+  size_t len_;
+  uint64_t local_[16]; // packed bases followed by the N bitmask
+  std::vector<uint64_t> heap_;
+};
+
+
+// use:  c = encodeBase(b);
+// pre:  b is one of 'A','C','G','T' in either case
+// post: c is 0,1,2,3 respectively
+static inline uint8_t encodeBase(const char b) {
+  uint8_t x = (b & 4) >> 1;
+  return x + ((x ^ (b & 2)) >> 1);
+}
+
+
+// use:  w = load_bases(data, nbytes, pos);
+// pre:  data has nbytes valid bytes
+// post: base pos+j is in bits 2j of w for j = 0,...,31,
+//       bases past the end of data are 0
+static inline uint64_t load_bases(const char *data, size_t nbytes, size_t pos) {
+  size_t b = pos >> 2, sh = 2*(pos & 0x03);
+  uint64_t lo = 0, hi = 0;
+  if (b + 9 <= nbytes) {
+    memcpy(&lo, data + b, 8);
+    hi = (uint8_t) data[b+8];
+  } else if (b < nbytes) {
+    memcpy(&lo, data + b, std::min<size_t>(nbytes - b, 8));
+    if (nbytes - b > 8) {
+      hi = (uint8_t) data[b+8];
+    }
+  }
+  return sh ? ((lo >> sh) | (hi << (64 - sh))) : lo;
+}
+
+
+// use:  store_bases(data, pos, n, w);
+// pre:  0 < n <= 32, data has space for pos+n bases
+// post: bases pos,...,pos+n-1 of data are bits 0,...,2n-1 of w,
+//       all other bases are unchanged
+static inline void store_bases(char *data, size_t pos, size_t n, uint64_t w) {
+  size_t b = pos >> 2, sh = 2*(pos & 0x03);
+  size_t nbytes = ((pos + n + 3) >> 2) - b; // at most 9
+  uint64_t m = (n == 32) ? ~0ULL : ((1ULL << (2*n)) - 1);
+  w &= m;
+  uint64_t wlo = w << sh, mlo = m << sh;
+  uint64_t whi = sh ? (w >> (64 - sh)) : 0, mhi = sh ? (m >> (64 - sh)) : 0;
+
+  uint64_t lo = 0;
+  size_t nlo = std::min<size_t>(nbytes, 8);
+  memcpy(&lo, data + b, nlo);
+  lo = (lo & ~mlo) | wlo;
+  memcpy(data + b, &lo, nlo);
+  if (nbytes > 8) {
+    data[b+8] = (char) ((((uint8_t) data[b+8]) & ~mhi) | whi);
+  }
+}
+
+
+// use:  v = reverse_bases(w);
+// post: the 32 2-bit groups of w are in reverse order in v
+static inline uint64_t reverse_bases(uint64_t v) {
+  v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+  v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+  return __builtin_bswap64(v);
+}
+
+#endif // BFG_TWOBITCODEC_HPP
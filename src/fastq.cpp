@@ -2,6 +2,9 @@
 #include <string.h>
 #include <zlib.h>
 
+#include <iostream>
+#include <algorithm>
+
 #include "fastq.hpp"
 
 
@@ -9,11 +12,147 @@
 
 
 
-FastqFile::FastqFile(const vector<string> files) : kseq(NULL), fnames(files) {
+// use:  n = splitWindows(readv, seq, k);
+// post: seq has been appended to readv, if it is longer than max_window it has been
+//       split into n windows of at most max_window bases that overlap by k-1 bases,
+//       so every k-mer of seq is in exactly one window, otherwise n == 1
+size_t splitWindows(vector<string>& readv, const string& seq, size_t k) {
+  if (seq.size() <= max_window || k >= max_window) {
+    readv.push_back(seq);
+    return 1;
+  }
+  size_t step = max_window - (k - 1), n = 0;
+  for (size_t i = 0; ; i += step, ++n) {
+    readv.push_back(seq.substr(i, max_window));
+    if (i + max_window >= seq.size()) {
+      return n + 1;
+    }
+  }
+}
+
+
+// use:  ends = balanceBases(readv, parts);
+// post: ends has parts elements, part i of readv ends before ends[i] and starts
+//       where part i-1 ends, the parts are in order and have about the same number of bases
+vector<size_t> balanceBases(const vector<string>& readv, size_t parts) {
+  size_t total = 0;
+  for (auto& r : readv) {
+    total += r.size();
+  }
+  vector<size_t> ends;
+  size_t i = 0, bases = 0;
+  for (size_t p = 1; p <= parts; p++) {
+    size_t goal = (p == parts) ? total : total * p / parts;
+    // a read goes to the part that holds most of it
+    while (i < readv.size() && (bases + readv[i].size() / 2 < goal || p == parts)) {
+      bases += readv[i++].size();
+    }
+    ends.push_back(i);
+  }
+  return ends;
+}
+
+
+// use:  b = GuessQualityScale(files, scale);
+// post: scale is 33 or 64, the offset of the quality characters in the first reads of files,
+//       b is false if the characters fit neither, fasta files give 33
+bool GuessQualityScale(const vector<string>& files, size_t& scale) {
+  scale = 64;
+
+  size_t nread = 0;
+  unsigned char min = 255, max = 0;
+  for (auto& fname : files) {
+    GzipReader gr;
+    if (nread > 10000 || !gr.open(fname)) {
+      continue;
+    }
+    kseq_t *ks = kseq_init(&gr);
+    // for each read, check all quality scores
+    while (nread <= 10000 && kseq_read(ks) >= 0) {
+      nread++;
+      for (size_t i = 0; i < ks->qual.l; ++i) {
+        min = std::min(min, (unsigned char) ks->qual.s[i]);
+        max = std::max(max, (unsigned char) ks->qual.s[i]);
+      }
+    }
+    kseq_destroy(ks);
+    gr.close();
+  }
+
+  if (min > max) {
+    scale = 33; // no qualities
+    return true;
+  }
+  if (min < '!' || max > '~' || max-min > 62) {
+    return false;
+  }
+  // qualities up to 'K' are phred+33 Q42 at most, as phred+64 they would all be below Q12
+  if (min < 64 || max <= 'K') {
+    scale = 33;
+  }
+  return true;
+}
+
+
+// use:  b = CheckQualityScale(files, min_qual, scale, verbose);
+// pre:  min_qual > 0 and files exist
+// post: (b == true)  <==>  scale is 33 or 64 and min_qual fits it,
+//       scale has been guessed from the reads in files if it was 0
+bool CheckQualityScale(const vector<string>& files, size_t min_qual, size_t& scale, bool verbose) {
+  if (scale != 0) {
+    if (scale != 33 && scale != 64) {
+      cerr << "Invalid value for quality-scale, we only accept 64 and 33" << endl;
+      return false;
+    }
+  } else {
+    if (verbose) {
+      cerr << "Guessing quality scale:";
+    }
+    if (!GuessQualityScale(files, scale)) {
+      cerr << endl << "Could not guess quality scale from sequence reads, set manually to 33 or 64" << endl;
+      return false;
+    } else if (verbose) {
+      cerr << " quality scale " << scale << endl;
+    }
+  }
+  if (min_qual + scale > '~') {
+    cerr << "Invalid value for min-qual: " << min_qual << endl;
+    return false;
+  }
+  return true;
+}
+
+
+// use:  maskQuality(seq, qual, len, min_qual);
+// post: the bases of seq whose quality character is below min_qual have been replaced by N
+void maskQuality(char *seq, const char *qual, size_t len, char min_qual) {
+  for (size_t i = 0; i < len; i++) {
+    if (qual[i] < min_qual) {
+      seq[i] = 'N';
+    }
+  }
+}
+
+
+// use:  FastqFile FQ(files, threads, streams, min_qual);
+// post: the first of files has been opened, BGZF files are
+//       decompressed on up to threads threads,
+//       bases with quality characters below min_qual are read as N,
+//       if threads > 1 the records are parsed ahead on another thread,
+//       if streams > 1 up to streams files are read at once and
+//       read_next hands out their records in no particular order
+FastqFile::FastqFile(const vector<string> files, size_t threads, size_t streams, char min_qual) : fnames(files), fp(threads), kseq(NULL),
+  nthreads(threads > 0 ? threads : 1), nstreams(std::max<size_t>(std::min(streams, files.size()), 1)),
+  min_qual(min_qual), stop(false), corrupt(false), curpos(0) {
+  async = !fnames.empty() && (nstreams > 1 || nthreads > 1);
   fnit = fnames.begin();
   file_no = 0;
-  fp = gzopen(fnit->c_str(), "r");
-  kseq = kseq_init(fp);
+  if (async) {
+    startStreams();
+  } else if (fnit != fnames.end()) {
+    fp.open(*fnit);
+    kseq = kseq_init(&fp);
+  }
 }
 
 
@@ -25,26 +164,77 @@ FastqFile::~FastqFile() {
 void FastqFile::reopen() {
   close();
   fnit = fnames.begin();
-  fp = gzopen(fnit->c_str(), "r");
-  kseq = kseq_init(fp);
+  file_no = 0;
+  if (async) {
+    startStreams();
+  } else if (fnit != fnames.end()) {
+    fp.open(*fnit);
+    kseq = kseq_init(&fp);
+  }
 }
 
 
-// returns >=0 (length of seq), -1 end of last file, -2 truncated quality string
+// returns >=0 (length of seq), -1 end of last file, -2 truncated quality string,
+// -3 corrupt or truncated gzip input, which has been reported
 int FastqFile::read_next(char *read, size_t *read_len, string &seq, size_t *seq_len, unsigned int *file_id, char *qual) {
+  if (async) {
+    while (curpos == cur.n) {
+      unique_lock<mutex> lock(m);
+      if (!cur.recs.empty()) {
+        spare.push_back(Batch());
+        spare.back().recs.swap(cur.recs);
+      }
+      cv_batch.wait(lock, [this] { return !batches.empty() || running == 0; });
+      if (batches.empty()) {
+        return corrupt ? -3 : -1;
+      }
+      cur.recs.swap(batches.front().recs);
+      cur.n = batches.front().n;
+      batches.pop_front();
+      curpos = 0;
+      cv_space.notify_one();
+    }
+    const Record& rec = cur.recs[curpos++];
+    memcpy(read, rec.name.c_str(), rec.name.size() + 1);
+    *read_len = rec.name.size();
+    seq.assign(rec.seq);
+    *seq_len = rec.seq.size();
+    if (qual != NULL) {
+      memcpy(qual, rec.qual.c_str(), rec.qual.size() + 1);
+    }
+    if (file_id != NULL) {
+      *file_id = rec.file_no / 2;
+    }
+    return (int) rec.seq.size();
+  }
+
   int r;
+  if (kseq == NULL) {
+    return -1; // no files
+  }
   if ((r = kseq_read(kseq)) >= 0) {
     memcpy(read, kseq->name.s, kseq->name.l + 1); // 0-terminated string
     *read_len = kseq->name.l;
+    if (min_qual > 0 && kseq->qual.l == kseq->seq.l) {
+      maskQuality(kseq->seq.s, kseq->qual.s, kseq->seq.l, min_qual);
+    }
     seq.assign(kseq->seq.s);
     *seq_len = kseq->seq.l;
     if (qual != NULL) {
-      memcpy(qual, kseq->qual.s, kseq->qual.l + 1); // 0-terminated string
+      if (kseq->qual.l > 0) {
+        memcpy(qual, kseq->qual.s, kseq->qual.l + 1); // 0-terminated string
+      } else {
+        qual[0] = '\0'; // fasta has no quality string
+      }
     }
     if (file_id != NULL) {
       *file_id = file_no / 2;
     }
   } else if (r == -1) {
+    if (fp.error()) {
+      cerr << "Error: corrupt or truncated gzip input in " << *fnit << endl;
+      return -3;
+    }
     open_next();
     if (fnit != fnames.end()) {
       return read_next(read, read_len, seq, seq_len, file_id, qual);
@@ -60,25 +250,150 @@ vector<string>::const_iterator FastqFile::open_next() {
   if (fnit != fnames.end()) {
     // close current file
     kseq_destroy(kseq);
-    gzclose(fp);
+    fp.close();
     kseq = NULL;
 
     // get next file
     ++fnit;
     ++file_no;
     if (fnit != fnames.end()) {
-      fp = gzopen(fnit->c_str(), "r");
-      kseq = kseq_init(fp);
+      fp.open(*fnit);
+      kseq = kseq_init(&fp);
     }
   }
   return fnit;
 }
 
 void FastqFile::close() {
+  if (async) {
+    stopStreams();
+    fnit = fnames.end();
+  }
   if (kseq != NULL) {
     kseq_destroy(kseq);
     kseq = NULL;
-    gzclose(fp);
+    fp.close();
     fnit = fnames.end();
   }
 }
+
+
+// use:  FQ.startStreams();
+// pre:  no stream threads are running
+// post: nstreams threads are reading the files from the first one on,
+//       one stream reads them in order
+void FastqFile::startStreams() {
+  batches.clear();
+  cur = Batch();
+  curpos = 0;
+  next_file = 0;
+  running = nstreams;
+  stop = false;
+  corrupt = false;
+  for (size_t i = 0; i < nstreams; i++) {
+    streams.push_back(thread(&FastqFile::readStream, this));
+  }
+}
+
+
+// use:  FQ.stopStreams();
+// post: the stream threads have stopped and their batches have been dropped
+void FastqFile::stopStreams() {
+  if (!streams.empty()) {
+    {
+      unique_lock<mutex> lock(m);
+      stop = true;
+    }
+    cv_space.notify_all();
+    for (auto& t : streams) {
+      t.join();
+    }
+    streams.clear();
+  }
+  batches.clear();
+  spare.clear();
+  cur = Batch();
+  curpos = 0;
+}
+
+
+// use:  thread(&FastqFile::readStream, this)
+// post: files have been taken in turn and parsed until none are left,
+//       their records have been queued in batches for read_next
+void FastqFile::readStream() {
+  // the decompression threads are shared between the streams
+  GzipReader gr(std::max<size_t>(nthreads / nstreams, 1));
+  size_t max_batches = 2 * nstreams;
+  Batch batch;
+  bool stopped = false;
+
+  while (!stopped) {
+    size_t f;
+    {
+      unique_lock<mutex> lock(m);
+      if (stop || next_file == fnames.size()) {
+        break;
+      }
+      f = next_file++;
+    }
+    if (!gr.open(fnames[f])) {
+      cerr << "Error: Could not open file " << fnames[f] << endl;
+      continue;
+    }
+    kseq_t *ks = kseq_init(&gr);
+
+    while (true) {
+      int r = kseq_read(ks);
+      if (r >= 0) {
+        if (batch.n == batch.recs.size()) {
+          batch.recs.push_back(Record());
+        }
+        Record& rec = batch.recs[batch.n++];
+        rec.name.assign(ks->name.s, ks->name.l);
+        if (min_qual > 0 && ks->qual.l == ks->seq.l) {
+          maskQuality(ks->seq.s, ks->qual.s, ks->seq.l, min_qual);
+        }
+        rec.seq.assign(ks->seq.s, ks->seq.l);
+        if (ks->qual.l > 0) {
+          rec.qual.assign(ks->qual.s, ks->qual.l);
+        } else {
+          rec.qual.clear();
+        }
+        rec.file_no = f;
+      }
+      if (batch.n == batch_records || (r < 0 && batch.n > 0)) {
+        unique_lock<mutex> lock(m);
+        cv_space.wait(lock, [this, max_batches] { return stop || batches.size() < max_batches; });
+        if (stop) {
+          stopped = true;
+          break;
+        }
+        batches.push_back(Batch());
+        batches.back().recs.swap(batch.recs);
+        batches.back().n = batch.n;
+        // refill a batch that has been handed out, its strings are already allocated
+        batch.n = 0;
+        if (!spare.empty()) {
+          batch.recs.swap(spare.back().recs);
+          spare.pop_back();
+        }
+        cv_batch.notify_one();
+      }
+      if (r < 0) {
+        break;
+      }
+    }
+
+    kseq_destroy(ks);
+    if (!stopped && gr.error()) {
+      unique_lock<mutex> lock(m);
+      cerr << "Error: corrupt or truncated gzip input in " << fnames[f] << endl;
+      corrupt = true;
+    }
+    gr.close();
+  }
+
+  unique_lock<mutex> lock(m);
+  --running;
+  cv_batch.notify_all();
+}
@@ -8,22 +8,52 @@
 
 #include <vector>
 #include <string>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #include "Common.hpp"
+#include "GzipReader.hpp"
+
+// kseq reads through a GzipReader, which decompresses on its own threads
+static inline int gzipread(GzipReader *gr, void *buf, unsigned len) {
+  return gr->read(buf, len);
+}
 
 #ifndef KSEQ_INIT_READY
 #define KSEQ_INIT_READY
 #include "kseq.h"
-KSEQ_INIT(gzFile, gzread);
+KSEQ_INIT(GzipReader *, gzipread);
 #endif
 
-// initialize kseq structures
-//KSEQ_INIT(gzFile, gzread);
+
+// Records longer than this are split into windows that overlap by k-1 bases,
+// so the k-mers of one chromosome or long read are shared between threads
+static const size_t max_window = 1 << 20;
+
+size_t splitWindows(vector<string>& readv, const string& seq, size_t k);
+vector<size_t> balanceBases(const vector<string>& readv, size_t parts);
+bool GuessQualityScale(const vector<string>& files, size_t& scale);
+bool CheckQualityScale(const vector<string>& files, size_t min_qual, size_t& scale, bool verbose);
+void maskQuality(char *seq, const char *qual, size_t len, char min_qual);
 
 
+/* Short description:
+ *  - Reads the records of fasta/fastq files one at a time
+ *  - With threads > 1 the records are parsed ahead on a background thread
+ *    into a ring of reusable batches, read_next only copies them out
+ *  - With min_qual the bases whose quality character is below it are
+ *    replaced by N, so no k-mer covers them
+ *  - With streams > 1 up to streams files are read at once, each on its own
+ *    thread with its own decompression, and their records are handed out
+ *    in batches as they arrive, so the order of the records is not kept
+ *  - A corrupt or truncated gzip file is reported and read_next returns -3
+ *    instead of -1 when the records run out
+ * */
 class FastqFile {
  public:
-  FastqFile(const vector<string> fnames);
+  FastqFile(const vector<string> fnames, size_t threads = 1, size_t streams = 1, char min_qual = 0);
 
   ~FastqFile();
 
@@ -38,8 +68,38 @@ class FastqFile {
   vector<string>::const_iterator open_next(); // Method
 
   vector<string> fnames; // All fasta/fastq files
-  gzFile fp;
+  GzipReader fp;
   kseq_t *kseq;
+
+  // read-ahead and multi-stream mode
+  struct Record {
+    string name, seq, qual;
+    unsigned int file_no;
+  };
+  struct Batch {
+    vector<Record> recs; // the records keep their memory when the batch is reused
+    size_t n; // records in use
+    Batch() : n(0) {}
+  };
+  static const size_t batch_records = 1024; // records handed over at a time
+
+  void startStreams();
+  void stopStreams();
+  void readStream();
+
+  size_t nthreads, nstreams;
+  char min_qual; // quality character that bases need not to be masked, 0 for none
+  bool async; // records are parsed on the stream threads
+  vector<thread> streams;
+  mutex m;
+  condition_variable cv_batch, cv_space;
+  deque<Batch> batches; // full batches waiting for read_next
+  vector<Batch> spare; // batches handed out, to be filled again
+  size_t next_file, running; // next file to open, streams still reading
+  bool stop;
+  bool corrupt; // a stream found a corrupt or truncated gzip file
+  Batch cur; // the batch being handed out
+  size_t curpos;
 };
 
 #endif // FASTQ_H
@@ -1,5 +1,7 @@
 #include <cstdio>
 #include <ctime>
+#include <cstdint>
+#include <cassert>
 #include <iostream>
 
 #include "../BlockedBloomFilter.hpp"
@@ -64,7 +66,21 @@ int main(int argc, char *argv[]) {
 
 
   // compute false positive rate
-  printf("False positive ratio: %.6f\n", wrong / (0.0 + counter));
+  double ratio = wrong / (0.0 + counter);
+  printf("False positive ratio: %.6f\n", ratio);
+
+  // the count and the rate estimated from the bits set match what was inserted and measured
+  size_t c = BF.count();
+  assert(c > 0.95 * limit && c < 1.05 * limit);
+  double fill, maxfill, fillall, maxfillall;
+  double est = BF.sample(SIZE_MAX, fillall, maxfillall);
+  printf("Estimated false positive ratio: %.6f, %.2f%% bits set, fullest block %.2f%%\n", est, 100 * fillall, 100 * maxfillall);
+  assert(est > 0.8 * ratio && est < 1.25 * ratio);
+  assert(BF.estimate(fillall) == c && maxfillall >= fillall && maxfillall <= 1.0);
+  double fps = BF.sample(1000, fill, maxfill);
+  assert(fps > 0.7 * est && fps < 1.4 * est && fill > 0.9 * fillall && fill < 1.1 * fillall && maxfill <= maxfillall);
+  // the memory is the bits and the object itself
+  assert(BF.memory() >= BF.bits() / 8 && BF.memory() < BF.bits() / 8 + 1024);
   cout << &argv[0][2] << " completed successfully" << endl;
 
 }
@@ -0,0 +1,65 @@
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "../Kmer.hpp"
+#include "../BlockedBloomFilter.hpp"
+#include "../BloomFilterCache.hpp"
+
+
+Kmer randomKmer() {
+  string s(Kmer::k, 'A');
+  for (size_t i = 0; i < s.size(); i++) {
+    s[i] = "ACGT"[rand() & 3];
+  }
+  return Kmer(s.c_str()).rep();
+}
+
+
+// the cache answers exactly like the filter, repeated queries are hits
+void test_cache(size_t n) {
+  BlockedBloomFilter bf(n, 4, (uint32_t) time(NULL));
+  vector<Kmer> in, out;
+  for (size_t i = 0; i < n; i++) {
+    in.push_back(randomKmer());
+    bf.insert(in.back());
+    out.push_back(randomKmer());
+  }
+
+  BloomFilterCache cache(6);
+  for (size_t r = 0; r < 3; r++) {
+    for (size_t i = 0; i < n; i++) {
+      assert(cache.contains(bf, in[i]));
+      assert(cache.contains(bf, out[i]) == bf.contains(out[i]));
+    }
+  }
+  assert(cache.hits + cache.misses == 6*n);
+
+  // the same k-mer twice in a row always hits
+  size_t hits = cache.hits;
+  cache.contains(bf, out[0]);
+  cache.contains(bf, out[0]);
+  assert(cache.hits >= hits + 1);
+
+  // after clearing, the next query goes to the filter
+  cache.clear();
+  size_t misses = cache.misses;
+  cache.contains(bf, in[0]);
+  assert(cache.misses == misses + 1);
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+
+  Kmer::set_k(31);
+  test_cache(1000);
+  test_cache(20000);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -3,15 +3,64 @@
 #include <iostream>
 #include <map>
 #include <cassert>
+#include <cstdlib>
 
 #include "../CompressedCoverage.hpp"
 
 using namespace std;
+
+
+// word at a time scans against looking at every counter
+void check_scans(const CompressedCoverage& cc) {
+  size_t sz = cc.size(), low = 0, sum = 0;
+  vector<pair<int, int>> v;
+  for (size_t i = 0; i < sz; i++) {
+    size_t c = cc.covAt(i);
+    if (c < 2) {
+      low++;
+      sum += c;
+    } else if (v.empty() || v.back().second != (int) i) {
+      v.push_back(make_pair(i, i+1));
+    } else {
+      v.back().second++;
+    }
+  }
+  assert(cc.lowCoverageInfo() == make_pair(low, sum));
+  assert(cc.splittingVector() == v);
+}
+
+
+// bulk coverage against covering one interval at a time, local and pointer arrays
+void test_addCoverage() {
+  for (size_t r = 0; r < 500; r++) {
+    size_t sz = 1 + rand() % 150;
+    CompressedCoverage a(sz), b(sz);
+    for (size_t j = 0; j < 6 && !a.isFull(); j++) {
+      size_t s = rand() % sz, e = s + rand() % (sz - s), t = 1 + rand() % 3;
+      for (size_t x = 0; x < t; x++) {
+        a.cover(s, e);
+      }
+      b.addCoverage(s, e, t);
+      assert(a.isFull() == b.isFull());
+      if (!a.isFull()) {
+        for (size_t i = 0; i < sz; i++) {
+          assert(a.covAt(i) == b.covAt(i));
+        }
+        check_scans(b);
+      }
+    }
+  }
+}
+
+
 // strings created in python with:
 // f = lambda x,start,new: x[0:start*2] + new + x[start*2+len(new):]
 // x = "00"*28
 // f(x,12,"01"*12)
 int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  test_addCoverage();
+
   CompressedCoverage c1(28);
   string s1r = c1.toString();
   assert(s1r[63] == '1'); // Not pointer
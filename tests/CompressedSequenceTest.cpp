@@ -12,6 +12,23 @@ using namespace std;
 #include "../CompressedSequence.hpp"
 
 
+// base by base reference for CompressedSequence::jump, the case of s is ignored
+size_t naive_jump(const string& cs, const char *s, size_t i, int pos, bool reversed) {
+  size_t j = 0;
+  if (!reversed) {
+    while (s[i+j] != 0 && pos + j < cs.size() && (s[i+j] & 0xDF) == cs[pos+j]) {
+      j++;
+    }
+  } else {
+    const char *comp = "TGCA";
+    while (s[i+j] != 0 && (int) j <= pos && (s[i+j] & 0xDF) == comp[string("ACGT").find(cs[pos-j])]) {
+      j++;
+    }
+  }
+  return j;
+}
+
+
 int main(int argc, char *argv[]) {
   if (argc < 2) {
   cout << "usage: CompressedSequenceTest <n>\n and a random sequence of length 2^n will be tested" << endl;
@@ -75,6 +92,8 @@ int main(int argc, char *argv[]) {
   assert(C3.jump(T.c_str(), 0, 0, false) == 4);
   T = "TTCG";
   assert(C3.jump(T.c_str(), 0, 2, false) == 4);
+  T = "ttcg"; // reads can be in lower case
+  assert(C3.jump(T.c_str(), 0, 2, false) == 4);
   T = "ACCCG";
   assert(C3.jump(T.c_str(), 1, 7, true) == 4);
   T = string(10, 'A');
@@ -97,8 +116,48 @@ int main(int argc, char *argv[]) {
 
 
   CompressedSequence C4("ACGT");
+
+  // word level sub-range copies, reverse complements, joins and k-mers
+  string S(s);
+  for (size_t start = 0; start < 70 && start < LIM; start++) {
+    for (size_t len = 0; start + len <= LIM && len < 140; len += 13) {
+      CompressedSequence sub = C1.subSequence(start, len);
+      assert(sub.toString() == S.substr(start, len));
+
+      string rs = sub.rev().toString();
+      for (i = 0; i < len; i++) {
+        assert(rs[len-i-1] == letters[3-baseKey[S[start+i]]]);
+      }
+
+      if (len >= 4) {
+        CompressedSequence joined(sub);
+        joined.append(C1.subSequence(start+len-3, LIM-(start+len-3)), 3);
+        assert(joined.toString() == S.substr(start));
+      }
+    }
+    if (start + 4 <= LIM) {
+      assert(C1.getKmer(start).toString() == S.substr(start, 4));
+    }
+  }
   
 
+  // word parallel jump against the base by base version
+  string R = C1.rev().toString();
+  for (size_t t = 0; t < 2000; t++) {
+    int pos = rand() % LIM;
+    size_t len = rand() % 300;
+    bool reversed = (rand() & 1) == 1;
+    string r = reversed ? R.substr(LIM-1-pos, len) : S.substr(pos, len);
+    if (!r.empty() && (rand() & 1)) {
+      r[rand() % r.size()] = "ACGTNacgt"[rand() % 9];
+    }
+    r = string(rand() % 5, 'A') + r;
+    for (i = 0; i < 5 && i < r.size(); i++) {
+      assert(C1.jump(r.c_str(), i, pos, reversed) == naive_jump(S, r.c_str(), i, pos, reversed));
+    }
+  }
+
+
   cout << &argv[0][2] << " completed successfully" << endl;
   return 0;
 }
@@ -0,0 +1,63 @@
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <vector>
+
+using namespace std;
+
+#include "../CoverageCounts.hpp"
+
+
+// random intervals against plain counters, including widening and saturation
+void test_counts(unsigned int reps) {
+  for (unsigned int r = 0; r < reps; r++) {
+    size_t sz = 1 + rand() % 200;
+    CoverageCounts cc(sz);
+    vector<uint32_t> naive(sz, 0);
+    assert(cc.bits() == 4);
+
+    size_t rounds = rand() % 40;
+    for (size_t j = 0; j < rounds; j++) {
+      size_t s = rand() % sz, e = s + rand() % (sz - s);
+      size_t t = ((rand() % 20) == 0) ? (rand() % 70000) : (1 + rand() % 3);
+      cc.add(s, e, t);
+      for (size_t i = s; i <= e; i++) {
+        naive[i] = (uint32_t) min<size_t>(naive[i] + t, CoverageCounts::max_count);
+      }
+    }
+
+    CoverageCounts copy(cc), assigned;
+    assigned = cc;
+    for (size_t i = 0; i < sz; i++) {
+      assert(cc.at(i) == naive[i]);
+      assert(copy.at(i) == naive[i]);
+      assert(assigned.at(i) == naive[i]);
+    }
+    for (size_t j = 0; j < 20; j++) {
+      size_t s = rand() % sz, e = s + rand() % (sz - s);
+      uint64_t sum = 0;
+      for (size_t i = s; i <= e; i++) {
+        sum += naive[i];
+      }
+      assert(cc.sum(s, e) == sum);
+    }
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+
+  CoverageCounts cc(10);
+  cc.add(2, 5, 15);
+  assert(cc.bits() == 4);
+  cc.add(5, 6, 1);
+  assert(cc.bits() == 8);
+  assert(cc.at(5) == 16 && cc.at(6) == 1 && cc.at(2) == 15);
+  assert(cc.sum(0, 9) == 4*15 + 2);
+
+  test_counts(2000);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+using namespace std;
+
+#include "../DuplicateSet.hpp"
+
+
+// use:  s = randomSeq(len);
+// post: s is a random sequence of len bases, with a few N
+string randomSeq(size_t len) {
+  string s;
+  for (size_t i = 0; i < len; i++) {
+    s.push_back("ACGTACGTACGTN"[rand() % 13]);
+  }
+  return s;
+}
+
+
+// use:  rc = revComp(s);
+// post: rc is the reverse complement of s
+string revComp(const string& s) {
+  string rc;
+  for (size_t i = s.size(); i > 0; i--) {
+    char c = s[i-1];
+    rc.push_back(c == 'A' ? 'T' : c == 'C' ? 'G' : c == 'G' ? 'C' : c == 'T' ? 'A' : c);
+  }
+  return rc;
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  string buf;
+
+  // copies are counted up to 3, a reverse complement is a copy
+  DuplicateSet dups(1 << 20);
+  string read = randomSeq(100);
+  assert(dups.add(read.c_str(), read.size(), buf) == 0);
+  assert(dups.add(read.c_str(), read.size(), buf) == 1);
+  string rc = revComp(read);
+  assert(dups.add(rc.c_str(), rc.size(), buf) == 2);
+  for (size_t i = 0; i < 5; i++) {
+    assert(dups.add(read.c_str(), read.size(), buf) == 3);
+  }
+  assert(dups.reads() == 8 && dups.duplicates() == 7);
+
+  // a prefix, a palindrome and the empty read
+  assert(dups.add(read.c_str(), read.size() - 1, buf) == 0);
+  string pal = "ACGT";
+  assert(dups.add(pal.c_str(), pal.size(), buf) == 0 && dups.add(pal.c_str(), pal.size(), buf) == 1);
+  assert(dups.add("", 0, buf) == 0 && dups.add("", 0, buf) == 1);
+
+  // threads adding the same reads see each read once as new
+  vector<string> reads;
+  for (size_t i = 0; i < 5000; i++) {
+    reads.push_back(randomSeq(20 + rand() % 130));
+  }
+  DuplicateSet dups2(1 << 20);
+  atomic<size_t> firsts(0), seconds(0);
+  vector<thread> workers;
+  for (size_t t = 0; t < 4; t++) {
+    workers.push_back(thread([&, t]() {
+      string b;
+      for (size_t i = 0; i < reads.size(); i++) {
+        const string& r = reads[(i + t * 1000) % reads.size()];
+        size_t c = dups2.add(r.c_str(), r.size(), b);
+        if (c == 0) {
+          ++firsts;
+        } else if (c == 1) {
+          ++seconds;
+        }
+      }
+    }));
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+  assert(firsts == reads.size() && seconds == reads.size() && !dups2.full());
+
+  // a full table stops storing reads
+  DuplicateSet dups3(0);
+  for (size_t i = 0; i < 100; i++) {
+    assert(dups3.add(reads[i].c_str(), reads[i].size(), buf) == 0);
+  }
+  assert(dups3.full() && dups3.add(reads[99].c_str(), reads[99].size(), buf) == 0);
+  assert(dups3.add(reads[0].c_str(), reads[0].size(), buf) == 1);
+
+  // a table sized for the files holds all their reads, gzip files count for more
+  const char *fname = "DuplicateSetTest.tmp.fq";
+  FILE *f = fopen(fname, "w");
+  for (size_t i = 0; i < reads.size(); i++) {
+    fprintf(f, "@r%zu\n%s\n+\n%s\n", i, reads[i].c_str(), string(reads[i].size(), 'I').c_str());
+  }
+  fclose(f);
+  vector<string> files(1, fname);
+  DuplicateSet dups4(DuplicateSet::bytesForFiles(files));
+  for (size_t i = 0; i < reads.size(); i++) {
+    assert(dups4.add(reads[i].c_str(), reads[i].size(), buf) == 0);
+  }
+  assert(!dups4.full());
+  f = fopen(fname, "w");
+  fprintf(f, "\x1f\x8b");
+  for (size_t i = 0; i < 100000; i++) {
+    fputc(0, f);
+  }
+  fclose(f);
+  assert(DuplicateSet::bytesForFiles(files) >= 8 * 4 * 1000);
+  remove(fname);
+  files.push_back("no such file");
+  assert(DuplicateSet::bytesForFiles(files) == 8 * 64);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,153 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <zlib.h>
+
+using namespace std;
+
+#include "../fastq.hpp"
+
+
+// use:  recs = readAll(FQ);
+// post: recs holds name, sequence, quality and file id of every record FQ hands out
+vector<string> readAll(FastqFile& FQ) {
+  vector<string> recs;
+  char name[8192], qual[8192];
+  string seq;
+  size_t name_len, seq_len;
+  unsigned int file_id;
+  while (FQ.read_next(name, &name_len, seq, &seq_len, &file_id, qual) >= 0) {
+    assert(name_len == strlen(name) && seq_len == seq.size());
+    recs.push_back(string(name) + " " + seq + " " + qual + " " + to_string(file_id));
+  }
+  return recs;
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+
+  // files of different sizes, plain and gzip, fastq and fasta
+  vector<string> files;
+  vector<string> expected;
+  size_t sizes[] = {5000, 0, 1, 3000, 2500, 7};
+  for (size_t f = 0; f < 6; f++) {
+    string fname = "FastqFileTest" + to_string(f) + ((f % 2) ? ".fq.gz" : ".fq");
+    bool fasta = (f == 4);
+    gzFile gz = gzopen(fname.c_str(), (f % 2) ? "wb" : "wbT");
+    for (size_t i = 0; i < sizes[f]; i++) {
+      string name = "r" + to_string(f) + "_" + to_string(i);
+      string seq, qual;
+      for (size_t j = 0, len = 20 + rand() % 200; j < len; j++) {
+        seq.push_back("ACGTN"[rand() % 5]);
+        qual.push_back('!' + rand() % 40);
+      }
+      if (fasta) {
+        gzprintf(gz, ">%s\n%s\n", name.c_str(), seq.c_str());
+        qual.clear();
+      } else {
+        gzprintf(gz, "@%s\n%s\n+\n%s\n", name.c_str(), seq.c_str(), qual.c_str());
+      }
+      expected.push_back(name + " " + seq + " " + qual + " " + to_string(f / 2));
+    }
+    gzclose(gz);
+    files.push_back(fname);
+  }
+
+  // one stream keeps the order of the records, also when they are parsed ahead
+  for (size_t threads = 1; threads <= 3; threads += 2) {
+    FastqFile FQ(files, threads, 1);
+    assert(readAll(FQ) == expected);
+    FQ.reopen();
+    assert(readAll(FQ) == expected);
+  }
+
+  // bases below the minimum quality are read as N
+  vector<string> masked;
+  for (auto& e : expected) {
+    size_t a = e.find(' '), b = e.find(' ', a + 1), c = e.rfind(' ');
+    string seq = e.substr(a + 1, b - a - 1), qual = e.substr(b + 1, c - b - 1);
+    for (size_t i = 0; i < qual.size(); i++) {
+      if (qual[i] < '!' + 20) {
+        seq[i] = 'N';
+      }
+    }
+    masked.push_back(e.substr(0, a + 1) + seq + e.substr(b));
+  }
+  for (size_t threads = 1; threads <= 3; threads += 2) {
+    FastqFile FQ(files, threads, 1, '!' + 20);
+    assert(readAll(FQ) == masked);
+  }
+  size_t scale;
+  assert(GuessQualityScale(files, scale) && scale == 33);
+
+  // several streams hand out the same records in some order, also after reopen
+  sort(expected.begin(), expected.end());
+  for (size_t streams = 2; streams <= 8; streams += 3) {
+    FastqFile FQ(files, 2, streams);
+    for (size_t round = 0; round < 2; round++) {
+      vector<string> recs = readAll(FQ);
+      sort(recs.begin(), recs.end());
+      assert(recs == expected);
+      FQ.reopen();
+    }
+  }
+
+  // closing in the middle of the files stops the streams
+  {
+    FastqFile FQ(files, 1, 3);
+    char name[8192];
+    string seq;
+    size_t name_len, seq_len;
+    for (size_t i = 0; i < 100; i++) {
+      assert(FQ.read_next(name, &name_len, seq, &seq_len, NULL) >= 0);
+    }
+    FQ.close();
+  }
+
+  for (size_t f = 0; f < files.size(); f++) {
+    remove(files[f].c_str());
+  }
+
+  // long records are split into windows that share k-1 bases,
+  // so the windows have the k-mers of the record, each one once
+  size_t k = 31;
+  for (size_t len = max_window - 1; len <= 3 * max_window; len += max_window / 2 + 7) {
+    string seq;
+    for (size_t i = 0; i < len; i++) {
+      seq.push_back("ACGT"[rand() % 4]);
+    }
+    vector<string> windows;
+    size_t n = splitWindows(windows, seq, k);
+    assert(n == windows.size() && (n == 1) == (len <= max_window));
+    string joined = windows[0];
+    for (size_t i = 1; i < n; i++) {
+      assert(windows[i].size() <= max_window && windows[i].compare(0, k - 1, joined, joined.size() - (k - 1), k - 1) == 0);
+      joined += windows[i].substr(k - 1);
+    }
+    assert(joined == seq);
+  }
+
+  // the parts have about the same number of bases
+  vector<string> readv;
+  for (size_t i = 0; i < 1000; i++) {
+    readv.push_back(string(1 + rand() % 300, 'A'));
+  }
+  readv.push_back(string(1000000, 'C'));
+  for (size_t parts = 1; parts <= 8; parts++) {
+    vector<size_t> ends = balanceBases(readv, parts);
+    assert(ends.size() == parts && ends.back() == readv.size());
+    for (size_t i = 1; i < parts; i++) {
+      assert(ends[i-1] <= ends[i]);
+    }
+  }
+  vector<size_t> ends = balanceBases(readv, 2);
+  assert(ends[0] == readv.size() - 1); // the long read is the second half
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,141 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <zlib.h>
+#include <unistd.h>
+
+using namespace std;
+
+#include "../GzipReader.hpp"
+
+
+// use:  writeBGZF(fname, data, block);
+// post: data has been written to fname as BGZF blocks of at most block bytes
+//       followed by the empty end of file block
+void writeBGZF(const char *fname, const string& data, size_t block) {
+  FILE *f = fopen(fname, "wb");
+  assert(f != NULL);
+  for (size_t i = 0; i <= data.size(); i += block) {
+    size_t n = min(block, data.size() - i);
+    if (i == data.size()) {
+      n = 0; // the end of file block
+    }
+    vector<unsigned char> cdata(compressBound(n) + 64);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    assert(deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    zs.next_in = (Bytef *) data.data() + i;
+    zs.avail_in = n;
+    zs.next_out = &cdata[0];
+    zs.avail_out = cdata.size();
+    assert(deflate(&zs, Z_FINISH) == Z_STREAM_END);
+    size_t clen = cdata.size() - zs.avail_out;
+    deflateEnd(&zs);
+
+    size_t bsize = 18 + clen + 8 - 1;
+    unsigned char h[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff, 6, 0, 'B', 'C', 2, 0,
+                           (unsigned char) (bsize & 0xff), (unsigned char) (bsize >> 8)};
+    uint32_t crc = crc32(0L, (const Bytef *) data.data() + i, n);
+    unsigned char t[8];
+    for (size_t j = 0; j < 4; j++) {
+      t[j] = (crc >> (8*j)) & 0xff;
+      t[4+j] = (n >> (8*j)) & 0xff;
+    }
+    fwrite(h, 1, 18, f);
+    fwrite(&cdata[0], 1, clen, f);
+    fwrite(t, 1, 8, f);
+    if (n == 0) {
+      break;
+    }
+  }
+  fclose(f);
+}
+
+
+// use:  s = readAll(fname, threads, bgzf, corrupt);
+// post: s is the content of fname read with a GzipReader in pieces of random size,
+//       bgzf tells if the file was detected as BGZF, corrupt if it ended early
+string readAll(const char *fname, size_t threads, bool& bgzf, bool& corrupt) {
+  GzipReader gr(threads);
+  assert(gr.open(fname));
+  bgzf = gr.isBGZF();
+  string s;
+  char buf[20000];
+  int n;
+  while ((n = gr.read(buf, 1 + rand() % sizeof(buf))) > 0) {
+    s.append(buf, n);
+  }
+  assert(n == 0);
+  assert(gr.read(buf, sizeof(buf)) == 0);
+  corrupt = gr.error();
+  gr.close();
+  return s;
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+
+  // fastq-like data, large enough for many batches
+  string data;
+  while (data.size() < 12000000) {
+    data += "@read\n";
+    for (size_t j = 0; j < 100; j++) {
+      data.push_back("ACGT"[rand() & 3]);
+    }
+    data += "\n+\n" + string(100, 'I') + "\n";
+  }
+  bool bgzf, corrupt;
+
+  // BGZF on one and several threads
+  writeBGZF("GzipReaderTest.bgz", data, 65280);
+  for (size_t t = 1; t <= 4; t += 3) {
+    assert(readAll("GzipReaderTest.bgz", t, bgzf, corrupt) == data);
+    assert(bgzf && !corrupt);
+  }
+
+  // a single gzip member and a plain file use gzread
+  gzFile gz = gzopen("GzipReaderTest.gz", "wb");
+  gzwrite(gz, data.data(), data.size());
+  gzclose(gz);
+  assert(readAll("GzipReaderTest.gz", 4, bgzf, corrupt) == data);
+  assert(!bgzf && !corrupt);
+  FILE *f = fopen("GzipReaderTest.txt", "wb");
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  assert(readAll("GzipReaderTest.txt", 4, bgzf, corrupt) == data);
+  assert(!bgzf && !corrupt);
+
+  // small and empty BGZF files
+  writeBGZF("GzipReaderTest.bgz", "@r\nACGT\n+\nIIII\n", 5);
+  assert(readAll("GzipReaderTest.bgz", 2, bgzf, corrupt) == "@r\nACGT\n+\nIIII\n" && !corrupt);
+  writeBGZF("GzipReaderTest.bgz", "", 100);
+  assert(readAll("GzipReaderTest.bgz", 2, bgzf, corrupt) == "" && !corrupt);
+
+  // a truncated BGZF or gzip file ends early instead of hanging and is an error
+  writeBGZF("GzipReaderTest.bgz", data, 65280);
+  assert(truncate("GzipReaderTest.bgz", 1000000) == 0);
+  string s = readAll("GzipReaderTest.bgz", 3, bgzf, corrupt);
+  assert(s.size() < data.size() && data.compare(0, s.size(), s) == 0);
+  assert(corrupt);
+  gz = gzopen("GzipReaderTest.gz", "wb");
+  gzwrite(gz, data.data(), data.size());
+  gzclose(gz);
+  assert(truncate("GzipReaderTest.gz", 1000000) == 0);
+  s = readAll("GzipReaderTest.gz", 1, bgzf, corrupt);
+  assert(s.size() < data.size() && data.compare(0, s.size(), s) == 0);
+  assert(!bgzf && corrupt);
+
+  assert(!GzipReader::detectBGZF((const unsigned char *) "@read\nACGT\n+\nIIII\n", 18));
+
+  remove("GzipReaderTest.bgz");
+  remove("GzipReaderTest.gz");
+  remove("GzipReaderTest.txt");
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
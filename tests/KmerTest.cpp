@@ -4,6 +4,7 @@
 #include <cstring>
 #include <cassert>
 #include <cmath>
+#include <string>
 
 #include "../Kmer.hpp"
 
@@ -183,6 +184,23 @@ int main(int argc, char *argv[]) {
     index++;
   }
 
+  // k can be changed, the k-mers made after that only use the new size
+  string seq;
+  for (j = 0; j < 2 * (int) Kmer::MAX_K; j++) {
+    seq.push_back(letters[(j * 7 + j / 3) % 4]);
+  }
+  for (unsigned int k2 = 1; k2 < Kmer::MAX_K; k2 += 3) {
+    Kmer::set_k(k2);
+    Kmer km(seq.c_str()), next(seq.c_str() + 1);
+    char str[Kmer::MAX_K + 1];
+    km.toString(str);
+    assert(strlen(str) == k2 && seq.compare(0, k2, str) == 0);
+    Kmer fw = km.forwardBase(seq[k2]);
+    assert(fw == next && memcmp(&fw, &next, sizeof(Kmer)) == 0);
+    Kmer tt = km.twin().twin();
+    assert(memcmp(&tt, &km, sizeof(Kmer)) == 0);
+  }
+
   cout << &argv[0][2] << " completed successfully" << endl;
   return 0;
 }
@@ -0,0 +1,72 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <vector>
+
+#include "../Kmer.hpp"
+#include "../KmerHashTable.h"
+#include "../LargeAlloc.hpp"
+
+using namespace std;
+
+
+// use:  b = held();
+// post: b is the number of bytes allocLarge holds on all kinds of pages
+size_t held() {
+  size_t b = 0;
+  for (size_t i = 0; i < PAGES_KINDS; i++) {
+    b += largePageBytes()[i];
+  }
+  return b;
+}
+
+
+int main(int argc, char *argv[]) {
+  Kmer::set_k(31);
+  size_t before = held();
+
+  // small and large allocations are aligned, writable and counted until they are freed
+  size_t sizes[] = {1, 1000, huge_page_size - 1, huge_page_size, 3 * huge_page_size + 12345};
+  vector<void *> ptrs;
+  for (size_t i = 0; i < 5; i++) {
+    uint8_t *p = (uint8_t *) allocLarge(sizes[i]);
+    assert(((uintptr_t) p) % 64 == 0);
+    memset(p, (int) i, sizes[i]);
+    assert(p[0] == i && p[sizes[i] - 1] == i);
+    ptrs.push_back(p);
+  }
+  assert(held() >= before + 6 * huge_page_size);
+  cout << "Allocated on " << largePageSummary() << endl;
+  for (size_t i = 0; i < 5; i++) {
+    freeLarge(ptrs[i], sizes[i]);
+  }
+  freeLarge(NULL, 0);
+  assert(held() == before);
+
+  // hash tables on large pages keep their values through growing and free them with the table
+  {
+    KmerHashTable<vector<size_t>> map;
+    string s(40, 'A');
+    for (size_t i = 0; i < 100000; i++) {
+      for (size_t j = 0; j < 12; j++) {
+        s[j] = "ACGT"[(i >> (2 * j)) & 3];
+      }
+      map.insert(make_pair(Kmer(s.c_str()), vector<size_t>(3, i)));
+    }
+    assert(map.size() == 100000 && map.memory() >= huge_page_size);
+    for (size_t i = 0; i < 100000; i += 997) {
+      for (size_t j = 0; j < 12; j++) {
+        s[j] = "ACGT"[(i >> (2 * j)) & 3];
+      }
+      auto it = map.find(Kmer(s.c_str()));
+      assert(it != map.end() && it->second == vector<size_t>(3, i));
+    }
+    assert(held() >= before + map.memory());
+  }
+  assert(held() == before);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+  return 0;
+}
@@ -0,0 +1,151 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <zlib.h>
+
+using namespace std;
+
+#include "../MappedFastq.hpp"
+#include "../fastq.hpp"
+#include "../KmerIterator.hpp"
+
+
+// use:  seqs = readMapped(mf, parts);
+// post: seqs holds the sequences of mf read as parts byte ranges, in file order
+vector<string> readMapped(const MappedFastq& mf, size_t parts) {
+  vector<string> seqs;
+  string buf;
+  const char *seq;
+  size_t len;
+  for (size_t i = 0; i < parts; i++) {
+    size_t pos = mf.sync(mf.size() * i / parts), end = mf.size() * (i+1) / parts;
+    while (mf.next(pos, end, seq, len, buf)) {
+      seqs.push_back(string(seq, len));
+    }
+  }
+  return seqs;
+}
+
+
+// use:  seqs = readKseq(fname);
+// post: seqs holds the sequences of fname as FastqFile reads them
+vector<string> readKseq(const string& fname) {
+  vector<string> seqs;
+  FastqFile FQ(vector<string>(1, fname));
+  char name[8192];
+  string seq;
+  size_t name_len, seq_len;
+  while (FQ.read_next(name, &name_len, seq, &seq_len, NULL) >= 0) {
+    seqs.push_back(seq);
+  }
+  return seqs;
+}
+
+
+// use:  s = randomSeq(len);
+// post: s is a random sequence of len bases, with a few N
+string randomSeq(size_t len) {
+  string s;
+  for (size_t i = 0; i < len; i++) {
+    s.push_back("ACGTACGTACGTN"[rand() % 13]);
+  }
+  return s;
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  Kmer::set_k(31);
+
+  // fastq with quality lines that start with '@' and '+'
+  FILE *f = fopen("MappedFastqTest.fq", "wb");
+  vector<string> expected;
+  for (size_t i = 0; i < 2000; i++) {
+    string seq = randomSeq(1 + rand() % 150), qual(seq.size(), 'I');
+    qual[0] = "@+I"[rand() % 3];
+    fprintf(f, "@read%zu\n%s\n+\n%s\n", i, seq.c_str(), qual.c_str());
+    expected.push_back(seq);
+  }
+  fclose(f);
+
+  MappedFastq mf;
+  assert(mf.open("MappedFastqTest.fq"));
+  assert(readKseq("MappedFastqTest.fq") == expected);
+  for (size_t parts = 1; parts <= 64; parts *= 2) {
+    assert(readMapped(mf, parts) == expected);
+  }
+
+  // wrapped and unwrapped fasta with windows line breaks
+  for (size_t cr = 0; cr < 2; cr++) {
+    f = fopen("MappedFastqTest.fa", "wb");
+    expected.clear();
+    for (size_t i = 0; i < 50; i++) {
+      string seq = randomSeq(rand() % 3000);
+      size_t width = (i % 2) ? 60 : seq.size() + 1;
+      fprintf(f, ">chr%zu some description%s\n", i, cr ? "\r" : "");
+      for (size_t j = 0; j < seq.size(); j += width) {
+        fprintf(f, "%s%s\n", seq.substr(j, width).c_str(), cr ? "\r" : "");
+      }
+      expected.push_back(seq);
+    }
+    fclose(f);
+    assert(mf.open("MappedFastqTest.fa"));
+    if (!cr) {
+      assert(readKseq("MappedFastqTest.fa") == expected);
+    }
+    for (size_t parts = 1; parts <= 16; parts++) {
+      assert(readMapped(mf, parts) == expected);
+    }
+  }
+
+  // a fasta record without sequence is empty and the next header starts the next record
+  f = fopen("MappedFastqTest.fa", "wb");
+  fprintf(f, ">a\n>b\nACGT\n");
+  fclose(f);
+  expected.assign(1, "");
+  expected.push_back("ACGT");
+  assert(mf.open("MappedFastqTest.fa"));
+  assert(readKseq("MappedFastqTest.fa") == expected);
+  for (size_t parts = 1; parts <= 4; parts++) {
+    assert(readMapped(mf, parts) == expected);
+  }
+
+  // the k-mers of a view are those of the string, the rest of the buffer is ignored
+  string s = randomSeq(200);
+  for (size_t len = 0; len < 100; len++) {
+    KmerIterator it(s.c_str(), len), it2(s.substr(0, len).c_str()), end;
+    for (; it2 != end; ++it, ++it2) {
+      assert(it != end && it->first == it2->first && it->second == it2->second);
+    }
+    assert(it == end);
+  }
+
+  // fastq with the sequence and quality wrapped over two lines is left to kseq
+  f = fopen("MappedFastqTest.fq", "wb");
+  expected.clear();
+  for (size_t i = 0; i < 400; i++) {
+    string seq = randomSeq(100), qual(seq.size(), 'I');
+    fprintf(f, "@read%zu\n%s\n%s\n+\n%s\n%s\n", i, seq.substr(0, 50).c_str(), seq.substr(50).c_str(),
+            qual.substr(0, 50).c_str(), qual.substr(50).c_str());
+    expected.push_back(seq);
+  }
+  fclose(f);
+  assert(!mf.open("MappedFastqTest.fq"));
+  assert(readKseq("MappedFastqTest.fq") == expected);
+
+  // compressed files are left to kseq
+  gzFile gz = gzopen("MappedFastqTest.fq.gz", "wb");
+  gzprintf(gz, "@r\nACGT\n+\nIIII\n");
+  gzclose(gz);
+  assert(!mf.open("MappedFastqTest.fq.gz"));
+
+  remove("MappedFastqTest.fq");
+  remove("MappedFastqTest.fa");
+  remove("MappedFastqTest.fq.gz");
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,120 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "../Kmer.hpp"
+#include "../BlockedBloomFilter.hpp"
+#include "../PartitionedInserter.hpp"
+
+using namespace std;
+
+
+// use:  b = sameFilter(a, b);
+// post: b is true if the filters a and b are the same, bit for bit
+bool sameFilter(BlockedBloomFilter& a, BlockedBloomFilter& b) {
+  FILE *fa = tmpfile(), *fb = tmpfile();
+  a.WriteBloomFilter(fa);
+  b.WriteBloomFilter(fb);
+  rewind(fa);
+  rewind(fb);
+  int ca, cb;
+  do {
+    ca = fgetc(fa);
+    cb = fgetc(fb);
+  } while (ca == cb && ca != EOF);
+  fclose(fa);
+  fclose(fb);
+  return ca == cb;
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  Kmer::set_k(31);
+  uint32_t seed = rand();
+
+  // k-mers that are seen once, twice or more, some from second copies of reads
+  vector<Kmer> kmers;
+  vector<bool> twice;
+  string s(31, 'A');
+  for (size_t i = 0; i < 400000; i++) {
+    for (size_t j = 0; j < s.size(); j++) {
+      s[j] = "ACGT"[rand() % 4];
+    }
+    size_t copies = 1 + (rand() % 3 == 0) + (rand() % 5 == 0);
+    for (size_t c = 0; c < copies; c++) {
+      kmers.push_back(Kmer(s.c_str()).rep());
+      twice.push_back(rand() % 10 == 0);
+    }
+  }
+  for (size_t i = kmers.size() - 1; i > 0; i--) {
+    size_t j = rand() % (i + 1);
+    swap(kmers[i], kmers[j]);
+    swap(twice[i], twice[j]);
+  }
+
+  // filters of a few partitions and of one give the same bits as inserting one k-mer at a time
+  size_t nums[] = {30000000, 1000};
+  for (size_t t = 0; t < 2; t++) {
+    BlockedBloomFilter BF(nums[t], 4, seed), BF2(nums[t] / 2, 8, seed + 1);
+    BlockedBloomFilter PF(nums[t], 4, seed), PF2(nums[t] / 2, 8, seed + 1);
+    assert((PF.blocks() >> PartitionedInserter::partition_shift) > 0 || t == 1);
+    size_t ins = 0;
+    for (size_t i = 0; i < kmers.size(); i++) {
+      const Kmer& rep = kmers[i];
+      if (twice[i]) {
+        if (!BF2.contains(rep)) {
+          BF2.insert(rep);
+          ++ins;
+        }
+        continue;
+      }
+      // as FilterReads does, a k-mer that did not set all its bits goes into both
+      size_t r = BF.search(rep);
+      if (r == 0) {
+        if (!BF2.contains(rep)) {
+          BF2.insert(rep);
+          ++ins;
+        }
+      } else if (BF.insert(rep) == r) {
+        ++ins;
+      } else {
+        BF2.insert(rep);
+      }
+    }
+
+    PartitionedInserter P(PF, &PF2);
+    for (size_t i = 0; i < kmers.size(); i++) {
+      if (twice[i]) {
+        P.addTwice(kmers[i]);
+      } else {
+        P.add(kmers[i]);
+      }
+    }
+    P.flush();
+    assert(sameFilter(BF, PF) && sameFilter(BF2, PF2));
+    if (t == 0) {
+      // the buffers only change the order within the second filter, so few false positives
+      assert(P.inserted() <= ins + ins / 1000 && P.inserted() + ins / 1000 >= ins);
+    }
+
+    // with one filter the k-mers only go into it
+    BlockedBloomFilter RF(nums[t], 4, seed), QF(nums[t], 4, seed);
+    PartitionedInserter Q(QF, NULL);
+    for (size_t i = 0; i < kmers.size(); i++) {
+      if (!RF.contains(kmers[i])) {
+        RF.insert(kmers[i]);
+      }
+      Q.add(kmers[i]);
+    }
+    Q.flush();
+    assert(sameFilter(RF, QF));
+  }
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+  return 0;
+}
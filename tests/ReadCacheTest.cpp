@@ -0,0 +1,97 @@
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+#include "../ReadCache.hpp"
+
+
+// use:  u = upper(s);
+// post: u is s with 'a','c','g','t' in upper case and every other non-base as 'N'
+string upper(const string& s) {
+  string u(s);
+  for (size_t i = 0; i < u.size(); i++) {
+    char c = u[i] & 0xDF;
+    u[i] = (c == 'A' || c == 'C' || c == 'G' || c == 'T') ? c : 'N';
+  }
+  return u;
+}
+
+
+// random reads with runs of N's and other characters come back unchanged, twice
+void test_cache(size_t n) {
+  ReadCache rc;
+  assert(rc.create("ReadCacheTest.tmp"));
+
+  vector<string> reads;
+  size_t bases = 0;
+  for (size_t i = 0; i < n; i++) {
+    string s(rand() % 400, 'A');
+    for (size_t j = 0; j < s.size(); j++) {
+      s[j] = "ACGTacgt"[rand() & 7];
+    }
+    for (size_t r = rand() % 4; r > 0 && !s.empty(); r--) {
+      size_t p = rand() % s.size(), q = min(s.size(), p + rand() % 80);
+      for (size_t j = p; j < q; j++) {
+        s[j] = "NnRY."[rand() % 5];
+      }
+    }
+    reads.push_back(s);
+    bases += s.size();
+    rc.write(s);
+  }
+  assert(rc.reads() == n);
+  assert(rc.bases() == bases);
+  assert(rc.bytes() >= bases / 4);
+
+  string s;
+  for (size_t pass = 0; pass < 2; pass++) {
+    assert(rc.rewind());
+    for (size_t i = 0; i < n; i++) {
+      assert(rc.read_next(s) == (int) reads[i].size());
+      assert(s == upper(reads[i]));
+    }
+    assert(rc.read_next(s) == -1);
+  }
+  rc.remove();
+  assert(!rc.rewind());
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+
+  ReadCache rc;
+  assert(rc.create("ReadCacheTest.tmp"));
+  rc.write("ACGTNNNNACGT");
+  rc.write("");
+  rc.write("NNNN");
+  rc.write(string(100, 'C'));
+  assert(rc.bytes() < 12 + 4 + 100);
+  assert(rc.rewind());
+  string s;
+  assert(rc.read_next(s) == 12 && s == "ACGTNNNNACGT");
+  assert(rc.read_next(s) == 0 && s == "");
+  assert(rc.read_next(s) == 4 && s == "NNNN");
+  assert(rc.read_next(s) == 100 && s == string(100, 'C'));
+  assert(rc.read_next(s) == -1);
+  rc.remove();
+
+  // a record cut short is an error and not the end of the cache
+  assert(rc.create("ReadCacheTest.tmp"));
+  assert(rc.write("ACGTACGT") && rc.write(string(100, 'G')));
+  assert(rc.rewind());
+  assert(truncate("ReadCacheTest.tmp", rc.bytes() - 5) == 0);
+  assert(rc.read_next(s) == 8 && s == "ACGTACGT");
+  assert(rc.read_next(s) == -2);
+  rc.remove();
+
+  test_cache(3000);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "../ReadNormalizer.hpp"
+#include "../KmerIterator.hpp"
+
+
+// use:  s = randomSeq(len);
+// post: s is a random sequence of len bases
+string randomSeq(size_t len) {
+  string s;
+  for (size_t i = 0; i < len; i++) {
+    s.push_back("ACGT"[rand() % 4]);
+  }
+  return s;
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  Kmer::set_k(31);
+
+  // reads of the same genome are kept until its k-mers reach the coverage
+  string genome = randomSeq(10000);
+  size_t coverage = 5;
+  ReadNormalizer norm(1 << 20, coverage, 42);
+  size_t kept = 0;
+  for (size_t i = 0; i < 10000; i++) {
+    size_t pos = rand() % (genome.size() - 100);
+    if (norm.keep(genome.substr(pos, 100))) {
+      ++kept;
+    }
+  }
+  assert(norm.reads() == 10000 && norm.kept() == kept);
+  // about coverage * genome / read length reads are needed, a few more at the ends
+  assert(kept >= coverage * genome.size() / 100 / 2 && kept <= 4 * coverage * genome.size() / 100);
+
+  // the counts never undercount and stop near the coverage
+  KmerIterator it(genome.c_str()), end;
+  size_t high = 0;
+  for (; it != end; ++it) {
+    size_t c = norm.count(it->first.rep());
+    if (c > 2 * coverage + 10) {
+      ++high;
+    }
+  }
+  assert(high < genome.size() / 100);
+
+  // reverse complements count as the same k-mers
+  ReadNormalizer norm2(1 << 16, 1, 7);
+  string read = randomSeq(80), rc;
+  for (size_t i = read.size(); i > 0; i--) {
+    rc.push_back("TGCA"[string("ACGT").find(read[i-1])]);
+  }
+  assert(norm2.keep(read));
+  assert(!norm2.keep(read));
+  assert(!norm2.keep(rc));
+
+  // reads without k-mers are kept, also a tiny sketch works
+  ReadNormalizer norm3(0, 1, 0);
+  assert(norm3.keep("ACGT") && norm3.keep("ACGT") && norm3.keep(""));
+  assert(norm3.keep(read) && !norm3.keep(read));
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "../SequenceArena.hpp"
+
+
+// random strings of every length up to 200 come back unchanged
+void test_arena(size_t n) {
+  SequenceArena arena;
+  vector<string> strs;
+  vector<size_t> offsets;
+  for (size_t i = 0; i < n; i++) {
+    string s(rand() % 200, 'A');
+    for (size_t j = 0; j < s.size(); j++) {
+      s[j] = "ACGT"[rand() & 3];
+    }
+    strs.push_back(s);
+    offsets.push_back(arena.add(s));
+  }
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < n; i++) {
+    assert(arena.get(offsets[i], strs[i].size()) == strs[i]);
+    bytes += (strs[i].size() + 3) / 4;
+  }
+  assert(arena.size() == bytes);
+
+  arena.clear();
+  assert(arena.size() == 0);
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+
+  SequenceArena arena;
+  size_t a = arena.add("ACGTTGCA"), b = arena.add("T"), c = arena.add("");
+  assert(arena.get(a, 8) == "ACGTTGCA");
+  assert(arena.get(b, 1) == "T");
+  assert(arena.get(c, 0) == "");
+  assert(arena.size() == 3);
+
+  test_arena(5000);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
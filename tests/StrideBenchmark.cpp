@@ -0,0 +1,116 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+using namespace std;
+
+#include "../Kmer.hpp"
+#include "../KmerIterator.hpp"
+#include "../BlockedBloomFilter.hpp"
+#include "../ContigMapper.hpp"
+#include "../fastq.hpp"
+
+
+double seconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// use:  n = mapReads(cmap, reads, add)
+// post: every read has been mapped to cmap, unmapped k-mers start new contigs if add is true,
+//       n is the number of k-mers that did not map
+size_t mapReads(ContigMapper& cmap, const BlockedBloomFilter& bf, const vector<string>& reads, bool add) {
+  size_t unmapped = 0;
+  for (size_t r = 0; r < reads.size(); r++) {
+    KmerIterator iter(reads[r].c_str()), iterend;
+    Kmer km, rep;
+    if (iter != iterend) {
+      km = iter->first;
+      rep = km.rep();
+    }
+    while (iter != iterend) {
+      if (!bf.contains(rep)) {
+        iter.raise(km, rep);
+        continue;
+      }
+      ContigMap cm = cmap.findContig(km, reads[r], iter->second);
+      if (cm.isEmpty) {
+        ++unmapped;
+        if (add) {
+          cmap.addContig(km, reads[r], iter->second, string());
+          cm = cmap.findContig(km, reads[r], iter->second);
+        }
+      } else if (add) {
+        cmap.mapRead(cm);
+      }
+      for (size_t i = 0; i < cm.len; i++) {
+        iter.raise(km, rep);
+      }
+    }
+  }
+  return unmapped;
+}
+
+
+// usage: StrideBenchmark <bloom filter> <k> <fastq> [strides...]
+// builds the contigs of the reads once per stride and times a second
+// mapping pass against the finished index
+int main(int argc, char *argv[]) {
+  if (argc < 4) {
+    cerr << "usage: StrideBenchmark <bloom filter> <k> <fastq> [strides...]" << endl;
+    return 1;
+  }
+  Kmer::set_k(atoi(argv[2]));
+
+  BlockedBloomFilter bf;
+  FILE *f = fopen(argv[1], "rb");
+  if (f == NULL || !bf.ReadBloomFilter(f)) {
+    cerr << "error: could not read bloom filter " << argv[1] << endl;
+    return 1;
+  }
+  fclose(f);
+
+  vector<string> files(1, argv[3]), reads;
+  FastqFile FQ(files);
+  char name[8192];
+  string s;
+  size_t name_len, len;
+  while (FQ.read_next(name, &name_len, s, &len, NULL, NULL) >= 0) {
+    reads.push_back(s);
+  }
+  FQ.close();
+
+  vector<size_t> strides;
+  for (int i = 4; i < argc; i++) {
+    strides.push_back(atoi(argv[i]));
+  }
+  if (strides.empty()) {
+    size_t k = Kmer::k;
+    size_t defaults[] = {1, 4, k/2, k, 2*k, 4*k};
+    strides.assign(defaults, defaults + 6);
+  }
+
+  printf("%zu reads, k = %u\n", reads.size(), Kmer::k);
+  printf("%8s %12s %12s %10s %12s %10s\n", "stride", "shortcuts", "bytes", "build s", "map reads/s", "unmapped");
+  for (size_t i = 0; i < strides.size(); i++) {
+    ContigMapper cmap;
+    cmap.setStride(strides[i]);
+    cmap.mapBloomFilter(&bf);
+
+    double t = seconds();
+    mapReads(cmap, bf, reads, true);
+    double tb = seconds() - t;
+
+    t = seconds();
+    size_t unmapped = mapReads(cmap, bf, reads, false);
+    double tm = seconds() - t;
+
+    printf("%8zu %12zu %12zu %10.3f %12.0f %10zu\n", cmap.getStride(), cmap.shortcutCount(),
+           cmap.shortcutMemory(), tb, reads.size() / tm, unmapped);
+  }
+}
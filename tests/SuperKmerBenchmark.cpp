@@ -0,0 +1,73 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+using namespace std;
+
+#include "../Kmer.hpp"
+#include "../KmerIterator.hpp"
+#include "../SuperKmerIterator.hpp"
+
+
+double seconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// usage: SuperKmerBenchmark [reads] [read length] [m]
+// compares iterating k-mers one at a time against iterating super k-mers
+int main(int argc, char *argv[]) {
+  size_t nreads = (argc > 1) ? atoi(argv[1]) : 200000;
+  size_t len = (argc > 2) ? atoi(argv[2]) : 100;
+  size_t m = (argc > 3) ? atoi(argv[3]) : SuperKmerIterator::default_m;
+
+  srand(1);
+  Kmer::set_k(31);
+
+  vector<string> reads(nreads);
+  for (size_t r = 0; r < nreads; r++) {
+    reads[r].resize(len);
+    for (size_t i = 0; i < len; i++) {
+      reads[r][i] = "ACGT"[rand() & 3];
+    }
+  }
+
+  double t = seconds();
+  size_t nkmers = 0, check = 0;
+  for (size_t r = 0; r < nreads; r++) {
+    KmerIterator it(reads[r].c_str()), it_end;
+    for (; it != it_end; ++it) {
+      check += it->first.hash() & 1;
+      ++nkmers;
+    }
+  }
+  double tk = seconds() - t;
+
+  t = seconds();
+  size_t nsuper = 0, ncovered = 0;
+  for (size_t r = 0; r < nreads; r++) {
+    SuperKmerIterator it(reads[r].c_str(), m), it_end;
+    for (; it != it_end; ++it) {
+      check += it->minimizer & 1;
+      ncovered += it->count;
+      ++nsuper;
+    }
+  }
+  double ts = seconds() - t;
+
+  if (ncovered != nkmers) {
+    cerr << "error: super k-mers cover " << ncovered << " k-mers, expected " << nkmers << endl;
+    return 1;
+  }
+
+  printf("k = %u, m = %zu, %zu reads of length %zu (%zu)\n", Kmer::k, m, nreads, len, check);
+  printf("KmerIterator:      %.3f s, %.1f M k-mers/s\n", tk, nkmers / tk / 1e6);
+  printf("SuperKmerIterator: %.3f s, %.1f M k-mers/s, %zu super k-mers, %.2f k-mers per super k-mer\n",
+         ts, nkmers / ts / 1e6, nsuper, (double) nkmers / nsuper);
+}
@@ -0,0 +1,83 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <ctime>
+#include <string>
+
+using namespace std;
+
+#include "../Kmer.hpp"
+#include "../KmerIterator.hpp"
+#include "../SuperKmerIterator.hpp"
+
+
+// canonical minimizer of the k-mer s, computed directly from the string
+uint64_t naive_minimizer(const string& s, size_t m) {
+  uint64_t best = 0, besthash = 0;
+  for (size_t i = 0; i + m <= s.size(); i++) {
+    uint64_t fw = 0, rc = 0;
+    for (size_t j = 0; j < m; j++) {
+      uint64_t c = string("ACGT").find(toupper(s[i+j]));
+      fw = (fw << 2) | c;
+      rc |= (3 - c) << (2*j);
+    }
+    uint64_t v = min(fw, rc), h = v;
+    h ^= h >> 33; h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33; h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    if (i == 0 || h < besthash) {
+      best = v;
+      besthash = h;
+    }
+  }
+  return best;
+}
+
+
+// super k-mers must cover the k-mers of KmerIterator in order, runs are maximal
+void test_runs(size_t m, unsigned int reps) {
+  size_t k = Kmer::k;
+  for (unsigned int r = 0; r < reps; r++) {
+    size_t len = rand() % 500;
+    string s(len, 'A');
+    for (size_t i = 0; i < len; i++) {
+      s[i] = ((rand() % 60) == 0) ? 'N' : "ACGTacgt"[rand() % 8];
+    }
+
+    KmerIterator it(s.c_str()), it_end;
+    SuperKmerIterator sit(s.c_str(), m), sit_end;
+    int last_end = -1;
+    uint64_t last_min = 0;
+    for (; sit != sit_end; ++sit) {
+      assert(sit->count > 0);
+      // a run that continues the previous one must have a new minimizer
+      if ((int) sit->pos == last_end) {
+        assert(sit->minimizer != last_min);
+      }
+      for (size_t i = 0; i < sit->count; i++) {
+        assert(it != it_end);
+        assert(it->second == (int) (sit->pos + i));
+        assert(it->first == sit->getKmer(i));
+        assert(naive_minimizer(s.substr(sit->pos + i, k), min(m, k)) == sit->minimizer);
+        ++it;
+      }
+      last_end = sit->pos + sit->count;
+      last_min = sit->minimizer;
+    }
+    assert(it == it_end);
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  Kmer::set_k(31);
+
+  size_t ms[] = {1, 7, 11, 15, 21, 31, 40};
+  for (size_t i = 0; i < sizeof(ms)/sizeof(ms[0]); i++) {
+    test_runs(ms[i], 200);
+  }
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
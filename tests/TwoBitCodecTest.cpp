@@ -0,0 +1,103 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cassert>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+#include "../TwoBitCodec.hpp"
+#include "../Kmer.hpp"
+#include "../KmerIterator.hpp"
+
+
+// compares every code path of the codec against a base by base encoding
+void test_level(CodecLevel level, unsigned int reps) {
+  const char letters[] = "ACGTacgtNnX";
+  const char *upper = "ACGT";
+
+  for (unsigned int r = 0; r < reps; r++) {
+    size_t len = rand() % 300;
+    string s(len, 'A');
+    for (size_t i = 0; i < len; i++) {
+      s[i] = ((rand() % 10) == 0) ? letters[rand() % 11] : upper[rand() & 3];
+    }
+
+    vector<uint64_t> packed((len+31)/32 + 1, ~0ULL), invalid((len+63)/64 + 1, ~0ULL);
+    encodeBases(s.c_str(), len, &packed[0], &invalid[0]);
+
+    string expected(len, 'A');
+    for (size_t i = 0; i < len; i++) {
+      size_t pos = string(upper).find(toupper(s[i]));
+      bool bad = (pos == string::npos);
+      assert(((invalid[i/64] >> (i%64)) & 1) == (bad ? 1 : 0));
+      uint64_t c = (packed[i/32] >> (2*(i%32))) & 0x03;
+      assert(c == (bad ? 0 : pos));
+      expected[i] = upper[c];
+    }
+    if (len % 32 != 0) {
+      assert((packed[len/32] >> (2*(len%32))) == 0);
+    }
+    if (len % 64 != 0) {
+      assert((invalid[len/64] >> (len%64)) == 0);
+    }
+
+    // decode from every offset
+    for (size_t offset = 0; offset < 9 && offset <= len; offset++) {
+      string out(len - offset, 0);
+      if (len > offset) {
+        decodeBases((const char *) &packed[0], offset, len - offset, &out[0]);
+      }
+      assert(out == expected.substr(offset));
+    }
+  }
+}
+
+
+// the k-mer iterator against scanning the string for N's directly
+void test_iterator(unsigned int reps) {
+  size_t k = Kmer::k;
+  for (unsigned int r = 0; r < reps; r++) {
+    size_t len = rand() % 500;
+    string s(len, 'A');
+    for (size_t i = 0; i < len; i++) {
+      s[i] = ((rand() % 40) == 0) ? 'N' : "ACGTacgt"[rand() % 8];
+    }
+
+    KmerIterator it(s.c_str()), it_end;
+    for (size_t i = 0; i + k <= len; i++) {
+      if (s.substr(i, k).find('N') != string::npos) {
+        continue;
+      }
+      assert(it != it_end);
+      assert(it->second == (int) i);
+      string km = s.substr(i, k);
+      for (size_t j = 0; j < k; j++) {
+        km[j] = toupper(km[j]);
+      }
+      assert(it->first.toString() == km);
+      ++it;
+    }
+    assert(it == it_end);
+  }
+}
+
+
+int main(int argc, char *argv[]) {
+  srand(time(NULL));
+  Kmer::set_k(31);
+
+  CodecLevel best = codecLevel();
+  for (int l = CODEC_SCALAR; l <= best; l++) {
+    assert(setCodecLevel((CodecLevel) l));
+    cout << "Testing codec " << codecName() << endl;
+    test_level((CodecLevel) l, 2000);
+    test_iterator(200);
+  }
+  setCodecLevel(best);
+
+  cout << &argv[0][2] << " completed successfully" << endl;
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+using namespace std;
+
+#include "../Kmer.hpp"
+#include "../BlockedBloomFilter.hpp"
+#include "../ContigMapper.hpp"
+
+
+double seconds() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// usage: WalkBenchmark [contigs] [contig length] [extra k-mers]
+// walks random contigs in a Bloom filter that is much larger than the cache,
+// one at a time with findContigSequence and interleaved with findContigSequences
+int main(int argc, char *argv[]) {
+  size_t ncontigs = (argc > 1) ? atoi(argv[1]) : 20000;
+  size_t len = (argc > 2) ? atoi(argv[2]) : 200;
+  size_t nextra = (argc > 3) ? atoi(argv[3]) : 10000000;
+
+  srand(1);
+  Kmer::set_k(31);
+  size_t k = Kmer::k;
+
+  // random contigs, and random k-mers to make the filter large
+  BlockedBloomFilter bf(ncontigs * (len - k + 1) + nextra, 8, 1);
+  vector<Kmer> seeds;
+  string s(len, 'A');
+  for (size_t c = 0; c < ncontigs; c++) {
+    for (size_t i = 0; i < len; i++) {
+      s[i] = "ACGT"[rand() & 3];
+    }
+    for (size_t i = 0; i + k <= len; i++) {
+      bf.insert(Kmer(s.c_str() + i).rep());
+    }
+    seeds.push_back(Kmer(s.c_str() + rand() % (len - k + 1)));
+  }
+  string x(k, 'A');
+  for (size_t j = 0; j < nextra; j++) {
+    for (size_t i = 0; i < k; i++) {
+      x[i] = "ACGT"[rand() & 3];
+    }
+    bf.insert(Kmer(x.c_str()).rep());
+  }
+
+  ContigMapper cmap;
+  cmap.mapBloomFilter(&bf);
+
+  double t = seconds();
+  size_t total1 = 0;
+  for (size_t i = 0; i < seeds.size(); i++) {
+    string seq;
+    bool selfLoop, strand;
+    size_t dist;
+    cmap.findContigSequence(seeds[i], seq, selfLoop, dist, strand);
+    Kmer km(seq.c_str() + dist);
+    if (km != (strand ? seeds[i] : seeds[i].twin())) {
+      cerr << "error: the seed is not at position " << dist << " of its contig" << endl;
+      return 1;
+    }
+    total1 += seq.size();
+  }
+  double t1 = seconds() - t;
+
+  t = seconds();
+  vector<string> seqs;
+  vector<bool> selfLoops;
+  cmap.findContigSequences(seeds, seqs, selfLoops);
+  size_t total2 = 0;
+  for (size_t i = 0; i < seqs.size(); i++) {
+    total2 += seqs[i].size();
+  }
+  double t2 = seconds() - t;
+
+  if (total1 != total2) {
+    cerr << "error: interleaved walks found " << total2 << " bases, expected " << total1 << endl;
+    return 1;
+  }
+
+  printf("%zu contigs of length %zu, %zu bases walked\n", ncontigs, len, total1);
+  printf("findContigSequence:  %.3f s, %.2f M k-mers/s\n", t1, total1 / t1 / 1e6);
+  printf("findContigSequences: %.3f s, %.2f M k-mers/s, %zu walks in turn\n",
+         t2, total2 / t2 / 1e6, ContigMapper::walk_batch);
+}
@@ -8,6 +8,14 @@ echo "Running KmerTestExtended"
 ./KmerTestExtended 31 5
 echo -e "\n"
 
+echo "Running TwoBitCodecTest"
+./TwoBitCodecTest
+echo -e "\n"
+
+echo "Running SuperKmerIteratorTest"
+./SuperKmerIteratorTest
+echo -e "\n"
+
 echo "Running CompressedSequenceTest"
 ./CompressedSequenceTest 20
 echo -e "\n"
@@ -26,3 +34,41 @@ echo "Running KmerMapperTest"
 echo "Running CompressedCoverageTest"
 ./CompressedCoverageTest
 echo -e "\n"
+
+echo "Running CoverageCountsTest"
+./CoverageCountsTest
+echo -e "\n"
+
+echo "Running BloomFilterCacheTest"
+./BloomFilterCacheTest
+echo -e "\n"
+
+echo "Running SequenceArenaTest"
+./SequenceArenaTest
+echo -e "\n"
+
+echo "Running ReadCacheTest"
+./ReadCacheTest
+echo -e "\n"
+
+echo "Running GzipReaderTest"
+./GzipReaderTest
+echo -e "\n"
+echo "Running FastqFileTest"
+./FastqFileTest
+echo -e "\n"
+echo "Running MappedFastqTest"
+./MappedFastqTest
+echo -e "\n"
+echo "Running ReadNormalizerTest"
+./ReadNormalizerTest
+echo -e "\n"
+echo "Running DuplicateSetTest"
+./DuplicateSetTest
+echo -e "\n"
+echo "Running LargeAllocTest"
+./LargeAllocTest
+echo -e "\n"
+echo "Running PartitionedInserterTest"
+./PartitionedInserterTest
+echo -e "\n"